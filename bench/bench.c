@@ -0,0 +1,504 @@
+// Benchmarks of the connectome simulation
+//
+// Measures, for the compiled-in network in each simulation
+// mode:
+//
+// - Ticks per second with no stimulus, and under the
+//   chemotaxis and nose touch stimuli of test/main.c
+// - Time per tick spent in each phase of ctm_neural_cycle
+// - Median, 99th percentile and worst time per tick
+// - Ticks per second with each stimulus registered (see
+//   ctm_register_stimulus), applied exactly and with
+//   CTM_MODE_FAST_STIMULUS
+//
+// and instance ticks per second for ensembles of growing
+// size and for batches of experiments run by growing
+// numbers of worker threads (up to one per core), and
+// ticks per second for synthetic networks of growing size
+// (see synthetic.h) in each mode with growing numbers of
+// threads, writing the results out as JSON
+//
+// Compile with:
+// gcc -O2 -DCTM_PROFILE -I./source -o ./nanotode_bench bench/bench.c source/*.c -lpthread -lm
+//
+// Usage:
+// nanotode_bench [-t ticks] [-s sizes] [-o results.json]
+//
+// -t: Ticks per measurement (defaults to 100000; synthetic
+//     networks run fewer in proportion to their size)
+// -s: Comma-separated numbers of neurons of the synthetic
+//     networks (defaults to 1000,10000,100000)
+// -o: Output file (defaults to standard output)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "defines.h"
+#include "connectome.h"
+#include "ensemble.h"
+#include "runner.h"
+#include "synthetic.h"
+
+#ifndef CTM_PROFILE
+#error "Compile the benchmarks with -DCTM_PROFILE"
+#endif
+
+// Ticks run before each measurement
+#define WARMUP_TICKS 1000
+
+// Ensemble sizes measured
+static const uint16_t ensemble_sizes[] = { 1, 8, 32, 128, 512 };
+
+// Experiments per worker in runner batches
+#define RUNNER_EXPERIMENTS 8
+
+// Synthetic network sizes measured by default, and the
+// most that can be given
+static const CtmId scaling_sizes[] = { 1000, 10000, 100000 };
+#define SCALING_SIZES_MAX 16
+
+// Ticks run on a synthetic network never drop below this
+#define SCALING_MIN_TICKS 100
+
+//
+// Scenarios
+//
+
+static const CtmId nose_touch[] = {
+  N_FLPR, N_FLPL, N_ASHL, N_ASHR, N_IL1VL, N_IL1VR,
+  N_OLQDL, N_OLQDR, N_OLQVR, N_OLQVL
+};
+
+static const CtmId chemotaxis[] = {
+  N_ADFL, N_ADFR, N_ASGR, N_ASGL, N_ASIL, N_ASIR,
+  N_ASJR, N_ASJL
+};
+
+typedef struct {
+  const char* name;
+  const CtmId* stimulus;
+  CtmId len;
+} Scenario;
+
+static const Scenario scenarios[] = {
+  { "quiescent", NULL, 0 },
+  { "chemotaxis", chemotaxis, sizeof(chemotaxis)/sizeof(chemotaxis[0]) },
+  { "nose_touch", nose_touch, sizeof(nose_touch)/sizeof(nose_touch[0]) }
+};
+
+typedef struct {
+  const char* name;
+  uint8_t flags;
+} Mode;
+
+static const Mode modes[] = {
+  { "push", 0 },
+  { "event", CTM_MODE_EVENT_DRIVEN },
+  { "pull", CTM_MODE_EVENT_DRIVEN | CTM_MODE_PULL },
+  { "deferred", CTM_MODE_EVENT_DRIVEN | CTM_MODE_DEFERRED_SATURATION },
+  { "deferred_pull", CTM_MODE_EVENT_DRIVEN | CTM_MODE_PULL | CTM_MODE_DEFERRED_SATURATION }
+};
+
+#define LEN(A) (sizeof(A)/sizeof(A[0]))
+
+static uint64_t clock_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u32(const void* a, const void* b) {
+  const uint32_t x = *(const uint32_t*)a;
+  const uint32_t y = *(const uint32_t*)b;
+
+  return (x > y) - (x < y);
+}
+
+// Set up a simulation in the given mode and run it past
+// its warm-up
+static void start(Connectome* const c, const CtmNetwork* const net, const Scenario* const s, const Mode* const m) {
+  ctm_init(c, net);
+  ctm_set_mode(c, m->flags);
+
+  for(uint32_t t = 0; t < WARMUP_TICKS; t++) {
+    ctm_neural_cycle(c, s->stimulus, s->len);
+  }
+}
+
+// Measure one scenario in one mode
+static void bench_scenario(FILE* const f, const CtmNetwork* const net, const Scenario* const s, const Mode* const m, const uint32_t ticks) {
+  Connectome c;
+
+  // Throughput, with nothing but the ticks timed
+  start(&c, net, s, m);
+
+  const uint64_t begin = clock_ns();
+
+  for(uint32_t t = 0; t < ticks; t++) {
+    ctm_neural_cycle(&c, s->stimulus, s->len);
+  }
+
+  const uint64_t elapsed = clock_ns() - begin;
+
+  ctm_free(&c);
+
+  // Per-tick latency
+  uint32_t* latency = malloc(ticks*sizeof(uint32_t));
+
+  start(&c, net, s, m);
+
+  for(uint32_t t = 0; t < ticks; t++) {
+    const uint64_t tick_begin = clock_ns();
+    ctm_neural_cycle(&c, s->stimulus, s->len);
+    latency[t] = (uint32_t)(clock_ns() - tick_begin);
+  }
+
+  ctm_free(&c);
+
+  qsort(latency, ticks, sizeof(uint32_t), compare_u32);
+
+  // Phase breakdown
+  CtmProfile profile;
+  memset(&profile, 0, sizeof(profile));
+
+  start(&c, net, s, m);
+  ctm_set_profile(&c, &profile);
+
+  for(uint32_t t = 0; t < ticks; t++) {
+    ctm_neural_cycle(&c, s->stimulus, s->len);
+  }
+
+  ctm_free(&c);
+
+  const double per_tick = (double)profile.ticks;
+
+  fprintf(f,
+    "    {\"scenario\": \"%s\", \"mode\": \"%s\", \"ticks\": %u, \"ticks_per_sec\": %.0f,\n"
+    "     \"latency_ns\": {\"p50\": %u, \"p99\": %u, \"max\": %u},\n"
+    "     \"phase_ns_per_tick\": {\"ping\": %.1f, \"discharge\": %.1f, \"idle\": %.1f, \"iterate\": %.1f}}",
+    s->name, m->name, ticks, ticks/(elapsed*1e-9),
+    latency[ticks/2], latency[(uint64_t)ticks*99/100], latency[ticks - 1],
+    profile.ping/per_tick, profile.discharge/per_tick, profile.idle/per_tick, profile.iterate/per_tick);
+
+  free(latency);
+}
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+// Measure a scenario in event-driven mode with its
+// stimulus registered (see ctm_register_stimulus), applied
+// exactly or with CTM_MODE_FAST_STIMULUS
+static void bench_stimulus_cache(FILE* const f, const CtmNetwork* const net, const Scenario* const s, const uint8_t fast, const uint32_t ticks) {
+  const Mode m = { fast ? "fast" : "exact", CTM_MODE_EVENT_DRIVEN | (fast ? CTM_MODE_FAST_STIMULUS : 0) };
+
+  Connectome c;
+  start(&c, net, s, &m);
+
+  const CtmStimulus stimulus = ctm_register_stimulus(&c, s->stimulus, s->len);
+
+  const uint64_t begin = clock_ns();
+
+  for(uint32_t t = 0; t < ticks; t++) {
+    ctm_stimulus_cycle(&c, stimulus);
+  }
+
+  const uint64_t elapsed = clock_ns() - begin;
+
+  ctm_free(&c);
+
+  fprintf(f,
+    "    {\"scenario\": \"%s\", \"stimulus\": \"%s\", \"ticks\": %u, \"ticks_per_sec\": %.0f}",
+    s->name, m.name, ticks, ticks/(elapsed*1e-9));
+}
+#endif
+
+// Measure an ensemble of the given size under the
+// chemotaxis stimulus, writing the separator before the
+// result; returns 0 (writing nothing) if memory runs out
+static uint8_t bench_ensemble(FILE* const f, const char* separator, const CtmNetwork* const net, const uint16_t instances, const uint32_t ticks) {
+  CtmEnsemble e;
+
+  if(!ctm_ensemble_init(&e, net, instances)) {
+    return 0;
+  }
+
+  CtmStimulusList* stim = malloc(instances*sizeof(CtmStimulusList));
+
+  if(stim == NULL) {
+    ctm_ensemble_free(&e);
+    return 0;
+  }
+
+  for(uint16_t i = 0; i < instances; i++) {
+    stim[i].id = chemotaxis;
+    stim[i].len = LEN(chemotaxis);
+  }
+
+  for(uint32_t t = 0; t < WARMUP_TICKS; t++) {
+    ctm_ensemble_cycle(&e, stim);
+  }
+
+  // Roughly the same work at every size
+  const uint32_t cycles = ticks/instances > 100 ? ticks/instances : 100;
+
+  const uint64_t begin = clock_ns();
+
+  for(uint32_t t = 0; t < cycles; t++) {
+    ctm_ensemble_cycle(&e, stim);
+  }
+
+  const uint64_t elapsed = clock_ns() - begin;
+
+  fprintf(f,
+    "%s    {\"instances\": %u, \"ticks\": %u, \"instance_ticks_per_sec\": %.0f}",
+    separator, instances, cycles, (double)cycles*instances/(elapsed*1e-9));
+
+  free(stim);
+  ctm_ensemble_free(&e);
+
+  return 1;
+}
+
+// Measure a batch of experiments under the test program's
+// stimuli, of uneven lengths, run by the given number of
+// workers
+static void bench_runner(FILE* const f, const CtmNetwork* const net, const uint16_t workers, const uint32_t ticks) {
+  static const CtmSchedulePhase schedule[] = {
+    { .stimulus = chemotaxis, .len = LEN(chemotaxis), .ticks = 1000 },
+    { .stimulus = nose_touch, .len = LEN(nose_touch), .ticks = 1000 }
+  };
+
+  const uint32_t len = (uint32_t)workers*RUNNER_EXPERIMENTS;
+
+  CtmExperiment* experiments = calloc(len, sizeof(CtmExperiment));
+  CtmExperimentResult* results = calloc(len, sizeof(CtmExperimentResult));
+  uint64_t total = 0;
+
+  for(uint32_t i = 0; i < len; i++) {
+    experiments[i].schedule = schedule;
+    experiments[i].phases = LEN(schedule);
+    experiments[i].ticks = ticks/2 + (uint64_t)ticks*(i % 4)/4;
+    experiments[i].mode = CTM_MODE_EVENT_DRIVEN;
+    experiments[i].noise = 2;
+    experiments[i].seed = i;
+
+    total += experiments[i].ticks;
+  }
+
+  CtmRunner r;
+  ctm_runner_init(&r, net, workers, 1);
+
+  const uint64_t begin = clock_ns();
+  ctm_runner_run(&r, experiments, results, len);
+  const uint64_t elapsed = clock_ns() - begin;
+
+  ctm_runner_free(&r);
+
+  fprintf(f,
+    "    {\"workers\": %u, \"experiments\": %u, \"ticks\": %llu, \"ticks_per_sec\": %.0f}",
+    workers, len, (unsigned long long)total, total/(elapsed*1e-9));
+
+  free(experiments);
+  free(results);
+}
+
+// Measure a synthetic network in one mode with the given
+// number of threads, stimulating a share of its neurons
+// like that of the chemotaxis stimulus
+// (relative to the compiled-in network's neurons)
+static void bench_scaling(FILE* const f, const CtmNetwork* const net, const CtmId base, const Mode* const m, const uint16_t threads, const uint32_t ticks) {
+  const CtmId neurons = net->neurons;
+  const CtmId len = (uint64_t)neurons*LEN(chemotaxis)/base > 0 ? (CtmId)((uint64_t)neurons*LEN(chemotaxis)/base) : 1;
+
+  CtmId* stimulus = malloc(len*sizeof(CtmId));
+
+  for(CtmId i = 0; i < len; i++) {
+    stimulus[i] = (CtmId)((uint64_t)i*neurons/len);
+  }
+
+  const Scenario s = { "synthetic", stimulus, len };
+
+  // Roughly the same number of connections visited at
+  // every size
+  uint64_t scaled = (uint64_t)ticks*base/neurons;
+  scaled = scaled > SCALING_MIN_TICKS ? scaled : SCALING_MIN_TICKS;
+  scaled = scaled < ticks ? scaled : ticks;
+
+  Connectome c;
+  start(&c, net, &s, m);
+
+#if defined(CTM_FRONTIER) && defined(CTM_PARALLEL)
+  const uint8_t threaded = ctm_set_threads(&c, threads);
+#else
+  const uint8_t threaded = threads == 1;
+#endif
+
+  const uint64_t begin = clock_ns();
+
+  for(uint64_t t = 0; t < scaled; t++) {
+    ctm_neural_cycle(&c, s.stimulus, s.len);
+  }
+
+  const uint64_t elapsed = clock_ns() - begin;
+
+  ctm_free(&c);
+
+  fprintf(f,
+    "    {\"neurons\": %u, \"cells\": %u, \"connections\": %u, \"mode\": \"%s\", \"threads\": %u, \"ticks\": %llu, \"ticks_per_sec\": %.0f, \"ns_per_tick\": %.0f%s}",
+    (unsigned)neurons, (unsigned)net->cells, (unsigned)net->_synapses.len, m->name, threaded ? threads : 1,
+    (unsigned long long)scaled, scaled/(elapsed*1e-9), (double)elapsed/scaled,
+    threaded ? "" : ", \"threads_failed\": true");
+
+  free(stimulus);
+}
+
+int main(int argc, char** argv) {
+  uint32_t ticks = 100000;
+  const char* out_path = NULL;
+
+  CtmId sizes[SCALING_SIZES_MAX];
+  uint32_t sizes_len = LEN(scaling_sizes);
+  memcpy(sizes, scaling_sizes, sizeof(scaling_sizes));
+
+  int opt;
+
+  while((opt = getopt(argc, argv, "t:s:o:")) != -1) {
+    switch(opt) {
+      case 't': ticks = (uint32_t)strtoul(optarg, NULL, 10); break;
+      case 's':
+        sizes_len = 0;
+
+        for(char* p = optarg; *p != '\0' && sizes_len < SCALING_SIZES_MAX; ) {
+          char* end;
+          const unsigned long n = strtoul(p, &end, 10);
+
+          if(end == p) {
+            break;
+          }
+
+          if(n > 0) {
+            sizes[sizes_len++] = (CtmId)n;
+          }
+
+          p = *end == ',' ? end + 1 : end;
+        }
+        break;
+      case 'o': out_path = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-t ticks] [-s sizes] [-o results.json]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if(ticks == 0) {
+    ticks = 1;
+  }
+
+  FILE* f = out_path != NULL ? fopen(out_path, "w") : stdout;
+
+  if(f == NULL) {
+    fprintf(stderr, "can't write %s\n", out_path);
+    return 1;
+  }
+
+  CtmNetwork net;
+
+  if(!ctm_network_builtin(&net)) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  fprintf(f, "{\n  \"cells\": %u, \"neurons\": %u,\n  \"scenarios\": [\n", (unsigned)net.cells, (unsigned)net.neurons);
+
+  for(uint32_t s = 0; s < LEN(scenarios); s++) {
+    for(uint32_t m = 0; m < LEN(modes); m++) {
+      bench_scenario(f, &net, &scenarios[s], &modes[m], ticks);
+      fprintf(f, s + 1 < LEN(scenarios) || m + 1 < LEN(modes) ? ",\n" : "\n");
+    }
+  }
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+  fprintf(f, "  ],\n  \"stimulus_cache\": [\n");
+
+  for(uint32_t s = 0; s < LEN(scenarios); s++) {
+    for(uint8_t fast = 0; fast < 2; fast++) {
+      bench_stimulus_cache(f, &net, &scenarios[s], fast, ticks);
+      fprintf(f, s + 1 < LEN(scenarios) || fast == 0 ? ",\n" : "\n");
+    }
+  }
+#endif
+
+  fprintf(f, "  ],\n  \"ensembles\": [\n");
+
+  const char* separator = "";
+
+  for(uint32_t i = 0; i < LEN(ensemble_sizes); i++) {
+    if(!bench_ensemble(f, separator, &net, ensemble_sizes[i], ticks)) {
+      fprintf(stderr, "can't allocate an ensemble of %u instances\n", (unsigned)ensemble_sizes[i]);
+      continue;
+    }
+
+    separator = ",\n";
+  }
+
+  fprintf(f, "\n");
+
+  fprintf(f, "  ],\n  \"runner\": [\n");
+
+  const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  for(uint16_t w = 1; ; w *= 2) {
+    // The last measurement uses every core
+    const uint16_t workers = (cores > 0 && w >= cores) ? (uint16_t)cores : w;
+
+    bench_runner(f, &net, workers, ticks);
+
+    if(cores <= 0 || workers >= cores) {
+      fprintf(f, "\n");
+      break;
+    }
+
+    fprintf(f, ",\n");
+  }
+
+  fprintf(f, "  ],\n  \"scaling\": [\n");
+
+  separator = "";
+
+  for(uint32_t i = 0; i < sizes_len; i++) {
+    CtmSyntheticParams params;
+    ctm_synthetic_default_params(&params, NULL, sizes[i]);
+
+    CtmNetwork synthetic;
+
+    if(!ctm_network_synthetic(&synthetic, &params)) {
+      fprintf(stderr, "can't generate a network of %u neurons\n", (unsigned)sizes[i]);
+      continue;
+    }
+
+    for(uint32_t m = 0; m < LEN(modes); m++) {
+      for(uint16_t w = 1; ; w *= 2) {
+        const uint16_t threads = (cores > 0 && w >= cores) ? (uint16_t)cores : w;
+
+        fputs(separator, f);
+        bench_scaling(f, &synthetic, net.neurons, &modes[m], threads, ticks);
+        separator = ",\n";
+
+        if(cores <= 0 || threads >= cores) {
+          break;
+        }
+      }
+    }
+
+    ctm_network_close(&synthetic);
+  }
+
+  fprintf(f, "\n  ]\n}\n");
+
+  ctm_network_close(&net);
+
+  return (out_path != NULL && fclose(f) != 0) ? 1 : 0;
+}
@@ -0,0 +1,270 @@
+#include "attractor.h"
+
+#ifdef CTM_SNAPSHOT
+
+// Hash of an array, eight bytes at a time
+static uint64_t ctm_attractor_hash(uint64_t h, const uint8_t* p, const size_t len) {
+  size_t i = 0;
+
+  for(; i + 8 <= len; i += 8) {
+    uint64_t w;
+    memcpy(&w, p + i, 8);
+
+    h = (h ^ w)*0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+  }
+
+  for(; i < len; i++) {
+    h = (h ^ p[i])*0x9E3779B97F4A7C15ull;
+  }
+
+  return h ^ (h >> 32);
+}
+
+// Hash of the cell states, which tells most states apart
+// far more cheaply than a full snapshot
+static uint64_t ctm_attractor_state_hash(Connectome* const c) {
+  const uint64_t h = ctm_attractor_hash(c->_neurons_tot, (const uint8_t*)ctm_neuron_state(c), c->_neurons_tot);
+
+  return ctm_attractor_hash(h, (const uint8_t*)ctm_muscle_state(c), c->_muscles_tot*sizeof(int16_t));
+}
+
+// Zero the idle counts of neurons at zero in a snapshot:
+// they only matter once such a neuron changes, so states
+// that differ in nothing else are taken to be the same
+static void ctm_attractor_mask(const Connectome* const c, uint8_t* const state) {
+  const int8_t* const neurons = (const int8_t*)(state + sizeof(CtmStateHeader));
+  uint8_t* const idle = state + sizeof(CtmStateHeader) + c->_neurons_tot + c->_muscles_tot*sizeof(int16_t);
+
+  for(CtmId id = 0; id < c->_neurons_tot; id++) {
+    if(neurons[id] == 0) {
+      idle[id] = 0;
+    }
+  }
+}
+
+// Set up a runner ticking the given connectome under the
+// given stimulus, looking for periods up to max_period
+// ticks; returns 0 if its buffers can't be allocated
+uint8_t ctm_attractor_init(CtmAttractor* const a, Connectome* const c, const CtmId* stim, const CtmId len, const uint32_t max_period) {
+  memset(a, 0, sizeof(*a));
+
+  a->_c = c;
+  a->_stim = stim;
+  a->_len = len;
+  a->max_period = max_period;
+
+  a->_state_size = ctm_state_size(c);
+  a->_checkpoint = malloc(a->_state_size);
+  a->_state = malloc(a->_state_size);
+
+  if(a->_checkpoint == NULL || a->_state == NULL) {
+    ctm_attractor_free(a);
+    return 0;
+  }
+
+  // The first checkpoint is the starting state
+  ctm_save_state(c, a->_checkpoint, a->_state_size);
+  ctm_attractor_mask(c, a->_checkpoint);
+  a->_checkpoint_hash = ctm_attractor_state_hash(c);
+  a->_power = 1;
+
+  a->_words = CTM_BITSET_WORDS(c->_neurons_tot);
+
+  return 1;
+}
+
+// Bring the connectome up to date, and release the runner
+void ctm_attractor_free(CtmAttractor* const a) {
+  if(a->_c != NULL) {
+    ctm_attractor_sync(a);
+  }
+
+  free(a->_checkpoint);
+  free(a->_state);
+  free(a->_neurons);
+  free(a->_muscles);
+  free(a->_discharges);
+
+  a->_checkpoint = NULL;
+  a->_state = NULL;
+  a->_neurons = NULL;
+  a->_muscles = NULL;
+  a->_discharges = NULL;
+}
+
+// Whether the cycle has been recorded, and ticks are being
+// replayed
+static uint8_t ctm_attractor_replaying(const CtmAttractor* const a) {
+  return a->period != 0 && a->_recorded == a->period;
+}
+
+// Copy the last tick's states into the recording
+static void ctm_attractor_record(CtmAttractor* const a) {
+  Connectome* const c = a->_c;
+  const uint32_t i = a->_recorded;
+
+  memcpy(a->_neurons + (size_t)i*c->_neurons_tot, ctm_neuron_state(c), c->_neurons_tot);
+  memcpy(a->_muscles + (size_t)i*c->_muscles_tot, ctm_muscle_state(c), c->_muscles_tot*sizeof(int16_t));
+
+  CtmBitWord* const bits = a->_discharges + (size_t)i*a->_words;
+
+#ifdef CTM_FRONTIER
+  memcpy(bits, c->_discharged, a->_words*sizeof(CtmBitWord));
+#else
+  ctm_bitset_clear(bits, a->_words);
+
+  for(CtmId id = 0; id < c->_neurons_tot; id++) {
+    if(ctm_get_discharge(c, id)) {
+      ctm_bitset_set(bits, id);
+    }
+  }
+#endif
+
+  a->_recorded++;
+}
+
+// Check the state after a tick against the checkpoint,
+// moving the checkpoint up every _power ticks
+static void ctm_attractor_detect(CtmAttractor* const a) {
+  Connectome* const c = a->_c;
+
+  const uint64_t hash = ctm_attractor_state_hash(c);
+
+  a->_lam++;
+
+  // The whole state is only compared (and saved) when the
+  // cell states look the same
+  uint8_t saved = 0;
+
+  if(hash == a->_checkpoint_hash) {
+    ctm_save_state(c, a->_state, a->_state_size);
+    ctm_attractor_mask(c, a->_state);
+    saved = 1;
+  }
+
+  if(saved && memcmp(a->_state, a->_checkpoint, a->_state_size) == 0) {
+    const uint32_t period = a->_lam;
+
+    a->_neurons = malloc((size_t)period*c->_neurons_tot);
+    a->_muscles = malloc((size_t)period*c->_muscles_tot*sizeof(int16_t));
+    a->_discharges = malloc((size_t)period*a->_words*sizeof(CtmBitWord));
+
+    // Without room to record the cycle, carry on simulating
+    if(a->_neurons == NULL || (a->_muscles == NULL && c->_muscles_tot > 0) || a->_discharges == NULL) {
+      free(a->_neurons);
+      free(a->_muscles);
+      free(a->_discharges);
+      a->_neurons = NULL;
+      a->_muscles = NULL;
+      a->_discharges = NULL;
+      a->_power = 0;
+      return;
+    }
+
+    a->period = period;
+    a->found_tick = a->tick;
+    return;
+  }
+
+  if(a->_lam == a->_power) {
+    if(!saved) {
+      ctm_save_state(c, a->_state, a->_state_size);
+      ctm_attractor_mask(c, a->_state);
+    }
+
+    uint8_t* const old = a->_checkpoint;
+    a->_checkpoint = a->_state;
+    a->_state = old;
+    a->_checkpoint_hash = hash;
+
+    a->_lam = 0;
+
+    if(a->_power <= a->max_period/2) {
+      a->_power *= 2;
+    }
+    else {
+      a->_power = a->max_period;
+    }
+  }
+}
+
+// Run one tick
+void ctm_attractor_cycle(CtmAttractor* const a) {
+  a->tick++;
+
+  if(ctm_attractor_replaying(a)) {
+    a->_phase = (a->_phase + 1) % a->period;
+    return;
+  }
+
+  ctm_neural_cycle(a->_c, a->_stim, a->_len);
+
+  if(a->period != 0) {
+    ctm_attractor_record(a);
+  }
+  else if(a->_power != 0 && a->max_period != 0) {
+    ctm_attractor_detect(a);
+  }
+}
+
+// Run the given number of ticks, replaying nothing but the
+// last once the period is known
+void ctm_attractor_skip(CtmAttractor* const a, uint64_t ticks) {
+  for(; ticks > 0 && !ctm_attractor_replaying(a); ticks--) {
+    ctm_attractor_cycle(a);
+  }
+
+  if(ticks > 0) {
+    a->tick += ticks;
+    a->_phase = (uint32_t)((a->_phase + ticks) % a->period);
+  }
+}
+
+// Simulate the ticks replayed since the start of the cycle,
+// so that the connectome's state is the current one
+void ctm_attractor_sync(CtmAttractor* const a) {
+  if(a->_phase == 0) {
+    return;
+  }
+
+  for(uint32_t i = 0; i < a->_phase; i++) {
+    ctm_neural_cycle(a->_c, a->_stim, a->_len);
+  }
+
+  a->_start = (a->_start + a->_phase) % a->period;
+  a->_phase = 0;
+}
+
+// Index in the recording of the last tick replayed
+static size_t ctm_attractor_last(const CtmAttractor* const a) {
+  return ((uint64_t)a->_start + a->_phase + a->period - 1) % a->period;
+}
+
+// State of every neuron and muscle after the last tick
+const int8_t* ctm_attractor_neuron_state(CtmAttractor* const a) {
+  if(!ctm_attractor_replaying(a) || a->_phase == 0) {
+    return ctm_neuron_state(a->_c);
+  }
+
+  return a->_neurons + ctm_attractor_last(a)*a->_c->_neurons_tot;
+}
+
+const int16_t* ctm_attractor_muscle_state(CtmAttractor* const a) {
+  if(!ctm_attractor_replaying(a) || a->_phase == 0) {
+    return ctm_muscle_state(a->_c);
+  }
+
+  return a->_muscles + ctm_attractor_last(a)*a->_c->_muscles_tot;
+}
+
+// Whether a neuron discharged in the last tick
+uint8_t ctm_attractor_discharge(CtmAttractor* const a, const CtmId id) {
+  if(!ctm_attractor_replaying(a) || a->_phase == 0) {
+    return ctm_get_discharge(a->_c, id);
+  }
+
+  return ctm_bitset_get(a->_discharges + ctm_attractor_last(a)*a->_words, id);
+}
+
+#endif
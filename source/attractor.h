@@ -0,0 +1,120 @@
+#ifndef ATTRACTOR_H
+#define ATTRACTOR_H
+
+#include <stdint.h>
+
+#include "defines.h"
+#include "connectome.h"
+#include "bitset.h"
+
+#ifdef CTM_SNAPSHOT
+
+//
+// Fast-forward through periodic orbits
+//
+// Under a constant stimulus the simulation is deterministic
+// with a finite state space, so it eventually repeats a
+// state and cycles from then on. A runner ticks a
+// connectome under a fixed stimulus list while looking for
+// the repeat by Brent's method: the state after every tick
+// is compared against a checkpoint taken at power-of-two
+// intervals, through a hash of the cell states, with any
+// match confirmed against a full snapshot (see
+// ctm_save_state). Once the period is known, one more
+// period is simulated to record every tick's neuron, muscle
+// and discharge states; after that, ticks are replayed from
+// the recording, and any number of them can be skipped at
+// once.
+//
+// While ticks are replayed, the connectome is left where
+// it was (and anything that follows it, such as a
+// locomotion decoder, isn't updated); ctm_attractor_sync
+// brings it up to date. Its mode and parameters mustn't be
+// changed while the runner is in use.
+//
+
+typedef struct {
+  Connectome* _c;
+
+  // Stimulus pinged every tick
+  const CtmId* _stim;
+  CtmId _len;
+
+  // Longest period looked for
+  uint32_t max_period;
+
+  // Ticks run
+  uint64_t tick;
+
+  // Period of the orbit, once found (zero until then), and
+  // the tick it was found at
+  uint32_t period;
+  uint64_t found_tick;
+
+  //
+  // Detection
+  //
+
+  // Snapshots of the state at the checkpoint and now, and
+  // the hash of the checkpoint's cell states
+  uint8_t* _checkpoint;
+  uint8_t* _state;
+  size_t _state_size;
+  uint64_t _checkpoint_hash;
+
+  // Ticks between checkpoints, and since the last one
+  uint32_t _power;
+  uint32_t _lam;
+
+  //
+  // Recording and replay
+  //
+
+  // States after each tick of the cycle (period entries
+  // each, discharges _words words per tick)
+  int8_t* _neurons;
+  int16_t* _muscles;
+  CtmBitWord* _discharges;
+  uint32_t _words;
+
+  // Ticks of the cycle recorded so far
+  uint32_t _recorded;
+
+  // Position in the cycle of the connectome's state (in
+  // ticks from the state the recording started from), and
+  // the ticks replayed since
+  uint32_t _start;
+  uint32_t _phase;
+} CtmAttractor;
+
+// Set up a runner ticking the given connectome under the
+// given stimulus (which must outlive it), looking for
+// periods up to max_period ticks; returns 0 if its buffers
+// can't be allocated
+uint8_t ctm_attractor_init(CtmAttractor* const, Connectome* const, const CtmId*, const CtmId, const uint32_t);
+
+// Brings the connectome up to date, and releases the runner
+void ctm_attractor_free(CtmAttractor* const);
+
+// Runs one tick
+void ctm_attractor_cycle(CtmAttractor* const);
+
+// Runs the given number of ticks, replaying nothing but
+// the last once the period is known
+void ctm_attractor_skip(CtmAttractor* const, uint64_t);
+
+// Simulates the ticks replayed since the start of the
+// cycle, so that the connectome's state is the current one
+void ctm_attractor_sync(CtmAttractor* const);
+
+// State of every neuron and muscle after the last tick
+// (valid until the next one)
+const int8_t* ctm_attractor_neuron_state(CtmAttractor* const);
+const int16_t* ctm_attractor_muscle_state(CtmAttractor* const);
+
+// Whether a neuron discharged in the last tick
+uint8_t ctm_attractor_discharge(CtmAttractor* const, const CtmId);
+
+#endif
+
+#endif
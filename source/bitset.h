@@ -0,0 +1,57 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stdint.h>
+#include <string.h>
+
+//
+// Packed bitsets indexed by cell id
+//
+
+typedef uint64_t CtmBitWord;
+
+#define CTM_BITS_PER_WORD 64
+
+// Number of words needed to hold N bits
+#define CTM_BITSET_WORDS(N) (((N) + CTM_BITS_PER_WORD - 1)/CTM_BITS_PER_WORD)
+
+static inline void ctm_bitset_set(CtmBitWord* const b, const uint32_t id) {
+  b[id/CTM_BITS_PER_WORD] |= (CtmBitWord)1 << (id % CTM_BITS_PER_WORD);
+}
+
+static inline uint8_t ctm_bitset_get(const CtmBitWord* const b, const uint32_t id) {
+  return (b[id/CTM_BITS_PER_WORD] >> (id % CTM_BITS_PER_WORD)) & 1;
+}
+
+static inline void ctm_bitset_clear(CtmBitWord* const b, const uint32_t words) {
+  memset(b, 0, words*sizeof(b[0]));
+}
+
+// Whether any bit of the first words is set
+static inline uint8_t ctm_bitset_any(const CtmBitWord* const b, const uint32_t words) {
+  CtmBitWord any = 0;
+
+  for(uint32_t w = 0; w < words; w++) {
+    any |= b[w];
+  }
+
+  return any != 0;
+}
+
+// Set bits 0 through n - 1, leaving the rest clear
+static inline void ctm_bitset_fill(CtmBitWord* const b, const uint32_t n) {
+  const uint32_t words = CTM_BITSET_WORDS(n);
+
+  memset(b, 0xFF, words*sizeof(b[0]));
+
+  if(n % CTM_BITS_PER_WORD) {
+    b[words - 1] = ((CtmBitWord)1 << (n % CTM_BITS_PER_WORD)) - 1;
+  }
+}
+
+// Index of the lowest set bit in a non-zero word
+static inline uint16_t ctm_bitword_lowest(const CtmBitWord w) {
+  return (uint16_t)__builtin_ctzll(w);
+}
+
+#endif
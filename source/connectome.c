@@ -1,30 +1,58 @@
 #include <stdio.h>
 #include "connectome.h"
+#include "pool.h"
 
-//
-// Utilities for parsing a ROM word into a connection
-// with an id and weight
-//
+// Hot loops are written once as always-inlined functions
+// that take the clamp range as arguments, and called with
+// constants for the default range so that case is compiled
+// as its own specialized loop
+#define CTM_INLINE static inline __attribute__((always_inline))
+
+#ifdef CTM_PROFILE
+#include <time.h>
+
+static uint64_t ctm_profile_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
 
-// Struct for representing a neuron connection
-typedef struct {
-  uint16_t id;
-  int8_t weight;
-} NeuronConnection;
+  return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+}
 
-static const NeuronConnection parse_rom_word(uint16_t rom_word) {
-  uint8_t* rom_byte;
-  rom_byte = (uint8_t*)&rom_word;
+// Phase timing within ctm_neural_cycle: CTM_PHASE_START
+// before the first phase, then CTM_PHASE_END after each
+// one with the profile field it adds to
+#define CTM_PHASE_START() \
+  uint64_t ctm_phase_time = c->_profile != NULL ? ctm_profile_clock() : 0
 
-  uint16_t id = rom_byte[1] + ((rom_byte[0] & 0b10000000) << 1);
-  
-  uint8_t weight_bits = rom_byte[0] & 0b01111111;
-  weight_bits = weight_bits + ((weight_bits & 0b01000000) << 1);
-  int8_t weight = (int8_t)weight_bits;
+#define CTM_PHASE_END(FIELD) do { \
+  if(c->_profile != NULL) { \
+    const uint64_t now = ctm_profile_clock(); \
+    c->_profile->FIELD += now - ctm_phase_time; \
+    ctm_phase_time = now; \
+  } \
+} while(0)
+#else
+#define CTM_PHASE_START()
+#define CTM_PHASE_END(FIELD)
+#endif
 
-  NeuronConnection neuron_conn = {id, weight};
+// Add to one of the current tick's counts (compiled out,
+// arguments and all, without CTM_STATS)
+#ifdef CTM_STATS
+#define CTM_COUNT(FIELD, N) (c->_stats_tick.FIELD += (N))
+#else
+#define CTM_COUNT(FIELD, N)
+#endif
 
-  return neuron_conn;
+// Clamp a neuron state into [lo, hi]
+CTM_INLINE int8_t ctm_clamp(const CtmSum val, const int8_t lo, const int8_t hi) {
+  if(val > hi) {
+    return hi;
+  }
+  else if(val < lo) {
+    return lo;
+  }
+  return (int8_t)val;
 }
 
 //
@@ -32,7 +60,7 @@ static const NeuronConnection parse_rom_word(uint16_t rom_word) {
 // 'current' and 'next' states
 //
 
-static int16_t ctm_get_current_state(Connectome* const c, const uint16_t id) {
+static int16_t ctm_get_current_state(Connectome* const c, const CtmId id) {
   if(id < c->_neurons_tot) {
     return c->_neuron_current[id];
   }
@@ -41,25 +69,21 @@ static int16_t ctm_get_current_state(Connectome* const c, const uint16_t id) {
   }
 }
 
-static void ctm_set_next_state(Connectome* const c, const uint16_t id, const int16_t val) {
+CTM_INLINE void ctm_set_next_state_in(Connectome* const c, const CtmId id, const CtmSum val, const int8_t lo, const int8_t hi) {
   if(id < c->_neurons_tot) {
-    if(val > 127) {
-      c->_neuron_next[id] = 127;
-    }
-    else if(val < -128) {
-      c->_neuron_next[id] = -128;
-    }
-    else {
-      c->_neuron_next[id] = val;
-    }
-    
+    CTM_COUNT(saturations, val > hi || val < lo);
+    c->_neuron_next[id] = ctm_clamp(val, lo, hi);
   }
   else {
-    c->_muscle_next[id - c->_neurons_tot] = val;
+    c->_muscle_next[id - c->_neurons_tot] = (int16_t)val;
   }
 }
 
-static int16_t ctm_get_next_state(Connectome* const c, const uint16_t id) {
+static void ctm_set_next_state(Connectome* const c, const CtmId id, const CtmSum val) {
+  ctm_set_next_state_in(c, id, val, c->_params.neuron_min, c->_params.neuron_max);
+}
+
+static int16_t ctm_get_next_state(Connectome* const c, const CtmId id) {
   if(id < c->_neurons_tot) {
     return c->_neuron_next[id];
   }
@@ -68,26 +92,260 @@ static int16_t ctm_get_next_state(Connectome* const c, const uint16_t id) {
   }
 }
 
-static void ctm_add_to_next_state(Connectome* const c, const uint16_t id, const int8_t val) {
-  int16_t curr_val = ctm_get_next_state(c, id);
-  ctm_set_next_state(c, id, curr_val + val);
+CTM_INLINE void ctm_add_to_next_state(Connectome* const c, const CtmId id, const CtmWeight val, const int8_t lo, const int8_t hi) {
+  CtmSum curr_val = ctm_get_next_state(c, id);
+  ctm_set_next_state_in(c, id, curr_val + val, lo, hi);
+
+#ifdef CTM_FRONTIER
+  if(id < c->_neurons_tot) {
+    ctm_bitset_set(c->_touched, id);
+  }
+#endif
 }
 
-// Copy 'next' state into 'current' state,
-// flush the muscles in 'next' state
+// Make 'next' state the 'current' state by swapping
+// buffers, then bring the new 'next' neurons up to date and
+// flush the muscles in it
 static void ctm_iterate_state(Connectome* const c) {
-  memcpy(c->_neuron_current, c->_neuron_next, c->_neurons_tot*sizeof(c->_neuron_next[0]));
-  memcpy(c->_muscle_current, c->_muscle_next, c->_muscles_tot*sizeof(c->_muscle_next[0]));
+  int8_t* const neurons = c->_neuron_current;
+  c->_neuron_current = c->_neuron_next;
+  c->_neuron_next = neurons;
+
+  int16_t* const muscles = c->_muscle_current;
+  c->_muscle_current = c->_muscle_next;
+  c->_muscle_next = muscles;
+
+#ifdef CTM_FRONTIER
+  // The old current state only differs from the new one
+  // where a neuron changed (neurons reset to zero are
+  // zeroed in both)
+  const CtmId words = CTM_BITSET_WORDS(c->_neurons_tot);
+
+  for(CtmId w = 0; w < words; w++) {
+    CtmBitWord bits = c->_changed[w];
+
+    while(bits) {
+      const CtmId id = w*CTM_BITS_PER_WORD + ctm_bitword_lowest(bits);
+      bits &= bits - 1;
+
+      c->_neuron_next[id] = c->_neuron_current[id];
+    }
+  }
+#else
+  memcpy(c->_neuron_next, c->_neuron_current, c->_neurons_tot*sizeof(c->_neuron_current[0]));
+#endif
 
   memset(c->_muscle_next, 0, c->_muscles_tot*sizeof(c->_muscle_next[0]));
+
+  c->neuron_state = c->_neuron_current;
+  c->muscle_state = c->_muscle_current;
+
+#ifdef CTM_FRONTIER
+  // Neurons touched this tick become next tick's frontier
+  CtmBitWord* frontier = c->_frontier;
+  c->_frontier = c->_touched;
+  c->_touched = frontier;
+
+  ctm_bitset_clear(c->_touched, CTM_BITSET_WORDS(c->_neurons_tot));
+#endif
 }
 
 //
 // Functions for handling meta/logging type information
 //
 
+#ifdef CTM_FRONTIER
+
+// Set flag in discharge bitset to indicate if neuron discharged
+static void ctm_meta_flag_discharge(Connectome* const c, const CtmId id, const uint8_t val) {
+  if(val == 0) {
+    c->_discharged[id/CTM_BITS_PER_WORD] &= ~((CtmBitWord)1 << (id % CTM_BITS_PER_WORD));
+  }
+  else if(val == 1) {
+    ctm_bitset_set(c->_discharged, id);
+  }
+}
+
+// Reset a neuron to zero; its current state is zeroed too,
+// as that buffer is the next state once the tick is done
+static void ctm_reset_neuron(Connectome* const c, const CtmId id) {
+  CTM_COUNT(idle_resets, c->_neuron_next[id] != 0);
+  c->_neuron_next[id] = 0;
+  c->_neuron_current[id] = 0;
+}
+
+// Take a neuron off the timing wheel
+static void ctm_wheel_unlink(Connectome* const c, const CtmId id) {
+  const CtmId next = c->_wheel_next[id];
+  const CtmId prev = c->_wheel_prev[id];
+
+  c->_wheel_next[prev] = next;
+  c->_wheel_prev[next] = prev;
+
+  c->_wheel_next[id] = id;
+  c->_wheel_prev[id] = id;
+}
+
+// (Re)schedule a neuron's reset in the given wheel slot
+static void ctm_wheel_link(Connectome* const c, const CtmId id, const uint8_t slot) {
+  const CtmId head = c->_neurons_tot + slot;
+
+  ctm_wheel_unlink(c, id);
+
+  c->_wheel_next[id] = c->_wheel_next[head];
+  c->_wheel_prev[id] = head;
+  c->_wheel_prev[c->_wheel_next[head]] = id;
+  c->_wheel_next[head] = id;
+}
+
+// Flush neurons that have been idle for a while
+//
+// Only neurons whose state changed or that discharged this
+// tick need attention. A change (re)schedules the neuron for
+// a reset max_idle + 1 ticks from now, which always lands in
+// the slot being drained this tick; a discharge that leaves
+// the state unchanged restarts the idle count one tick in,
+// and so schedules one tick sooner. Neurons still in the
+// slot being drained otherwise are reset.
+static void ctm_meta_handle_idle_neurons(Connectome* const c) {
+  const uint8_t slot = c->_wheel_slot;
+  const uint8_t max_idle = c->_params.max_idle;
+  const CtmId words = CTM_BITSET_WORDS(c->_neurons_tot);
+
+  c->_kernels->differ(c->_neuron_next, c->_neuron_current, c->_neurons_tot, c->_changed);
+
+  // Reset neurons that are due, other than those about to
+  // be rescheduled
+  const CtmId head = c->_neurons_tot + slot;
+
+  for(CtmId id = c->_wheel_next[head]; id != head; ) {
+    const CtmId next = c->_wheel_next[id];
+
+    if(!ctm_bitset_get(c->_changed, id) && !ctm_bitset_get(c->_discharged, id)) {
+      ctm_reset_neuron(c, id);
+      ctm_wheel_unlink(c, id);
+    }
+
+    id = next;
+  }
+
+  for(CtmId w = 0; w < words; w++) {
+    CtmBitWord bits = c->_changed[w] | c->_discharged[w];
+
+    while(bits) {
+      const CtmId id = w*CTM_BITS_PER_WORD + ctm_bitword_lowest(bits);
+      bits &= bits - 1;
+
+      if(ctm_bitset_get(c->_changed, id)) {
+        c->_idle_slot[id] = slot;
+        ctm_wheel_link(c, id, slot);
+      }
+      else if(ctm_bitset_get(c->_discharged, id)) {
+        // Discharged, but back to where it was
+        const uint8_t deadline_slot = (slot + max_idle) % (max_idle + 1);
+
+        c->_idle_slot[id] = deadline_slot;
+
+        if(max_idle == 0) {
+          ctm_reset_neuron(c, id);
+          ctm_wheel_unlink(c, id);
+        }
+        else {
+          ctm_wheel_link(c, id, deadline_slot);
+        }
+      }
+    }
+  }
+
+  // Neurons left past a lowered max_idle are reset whether
+  // or not they changed, unless a discharge restarted them
+  if(c->_overdue_any) {
+    for(CtmId w = 0; w < words; w++) {
+      CtmBitWord bits = c->_overdue[w] & ~c->_discharged[w];
+
+      while(bits) {
+        const CtmId id = w*CTM_BITS_PER_WORD + ctm_bitword_lowest(bits);
+        bits &= bits - 1;
+
+        ctm_reset_neuron(c, id);
+
+        if(!ctm_bitset_get(c->_changed, id)) {
+          c->_idle_slot[id] = slot;
+          ctm_wheel_link(c, id, slot);
+        }
+      }
+    }
+
+    ctm_bitset_clear(c->_overdue, words);
+    c->_overdue_any = 0;
+  }
+
+  c->_wheel_slot = (slot + 1) % (max_idle + 1);
+}
+
+// Number of ticks a neuron has been idle as of the last
+// tick, as kept in the lower bits of _meta without a wheel
+static uint8_t ctm_idle_count(const Connectome* const c, const CtmId id, const uint8_t max_idle) {
+  if(ctm_bitset_get(c->_overdue, id)) {
+    return c->_idle_slot[id];
+  }
+
+  const uint8_t slots = max_idle + 1;
+
+  const uint16_t count = c->_wheel_slot + slots - 1 - c->_idle_slot[id];
+
+  return count >= slots ? count - slots : count;
+}
+
+// (Re)build the timing wheel for the current max_idle from
+// every neuron's idle count under the old one
+static void ctm_wheel_build(Connectome* const c, const uint8_t old_max_idle) {
+  const uint8_t max_idle = c->_params.max_idle;
+  const CtmId n = c->_neurons_tot;
+
+  // Empty every list
+  for(CtmId i = n; i < n + CTM_WHEEL_SLOTS; i++) {
+    c->_wheel_next[i] = i;
+    c->_wheel_prev[i] = i;
+  }
+
+  // Counts are read off the old wheel before it goes; the
+  // new wheel starts over at slot zero
+  for(CtmId id = 0; id < n; id++) {
+    const uint8_t idle = ctm_idle_count(c, id, old_max_idle);
+
+    c->_overdue[id/CTM_BITS_PER_WORD] &= ~((CtmBitWord)1 << (id % CTM_BITS_PER_WORD));
+
+    c->_wheel_next[id] = id;
+    c->_wheel_prev[id] = id;
+
+    if(idle > max_idle) {
+      ctm_bitset_set(c->_overdue, id);
+      c->_overdue_any = 1;
+      c->_idle_slot[id] = idle;
+      continue;
+    }
+
+    // Slot zero is due next tick, when the count will be
+    // one higher
+    const uint8_t left = max_idle - idle;
+
+    c->_idle_slot[id] = left;
+
+    // Neurons at zero don't need resetting (their counts
+    // just keep cycling through their slot)
+    if(c->_neuron_next[id] != 0) {
+      ctm_wheel_link(c, id, left);
+    }
+  }
+
+  c->_wheel_slot = 0;
+}
+
+#else
+
 // Set flag in meta array to indicate if neuron discharged
-static void ctm_meta_flag_discharge(Connectome* const c, const uint16_t id, const uint8_t val) {
+static void ctm_meta_flag_discharge(Connectome* const c, const CtmId id, const uint8_t val) {
   if(val == 0) {
     c->_meta[id] = 0b01111111 & c->_meta[id];
   }
@@ -102,14 +360,14 @@ static void ctm_meta_handle_idle_neurons(Connectome* const c) {
   // _meta array high bit indicates whether neuron discharged
   // during previous tick, lower seven give number of ticks
   // that neuron was idle
-  for(uint16_t i = 0; i < c->_neurons_tot; i++) {
+  for(CtmId i = 0; i < c->_neurons_tot; i++) {
     uint8_t low_val = c->_meta[i] & 0b01111111;
     uint8_t high_val = c->_meta[i] & 0b10000000;
 
     uint8_t idle_ticks = low_val;
 
     if(ctm_get_next_state(c, i) == ctm_get_current_state(c, i)) {
-      // Doesnt matter if high bit is set as long as MAX_IDLE < 127
+      // Doesnt matter if high bit is set as long as max_idle < 127
       c->_meta[i] += 1;
       idle_ticks += 1;
     }
@@ -117,7 +375,8 @@ static void ctm_meta_handle_idle_neurons(Connectome* const c) {
       c->_meta[i] = high_val;
     }
 
-    if(idle_ticks > MAX_IDLE) {
+    if(idle_ticks > c->_params.max_idle) {
+      CTM_COUNT(idle_resets, ctm_get_next_state(c, i) != 0);
       ctm_set_next_state(c, i, 0);
       // Set number of idle ticks to zero (i.e. only preserve high bit)
       c->_meta[i] = high_val;
@@ -125,100 +384,1524 @@ static void ctm_meta_handle_idle_neurons(Connectome* const c) {
   }
 }
 
+#endif
+
 //
-// Functions that provide primary interface to
-// connectome emulation
+// Functions for finding neurons over threshold
 //
 
-// Function for initializing connectome struct
-void ctm_init(Connectome* const c) {
-  // Set number of neuron type cells
-  c->_neurons_tot = (uint16_t)NEURAL_ROM[0];
-  c->_muscles_tot = (uint8_t)(CELLS - c->_neurons_tot);
+#ifndef CTM_FRONTIER
+// Check every neuron against threshold
+static void ctm_discharge_scan(Connectome* const c) {
+  for(CtmId i = 0; i < c->_neurons_tot; i++) {
+    if(ctm_get_current_state(c, i) > c->_params.threshold) {
+      CTM_COUNT(discharges, 1);
+      ctm_discharge_neuron(c, i);
+      ctm_meta_flag_discharge(c, i, 1);
+    }
+    else {
+      ctm_meta_flag_discharge(c, i, 0);
+    }
+  }
+}
+#endif
 
-  // Allocate neuron state arrays
-  c->_neuron_current = malloc(c->_neurons_tot*sizeof(int8_t));
-  c->_neuron_next = malloc(c->_neurons_tot*sizeof(int8_t));
+#ifdef CTM_FRONTIER
+// Flag every neuron over threshold; current state is fixed
+// for the whole tick, so this can be done before any
+// discharge is propagated
+static void ctm_flag_discharges(Connectome* const c) {
+  const CtmId words = CTM_BITSET_WORDS(c->_neurons_tot);
 
-  // Allocate muscle state arrays
-  c->_muscle_current = malloc(c->_muscles_tot*sizeof(int16_t));
-  c->_muscle_next = malloc(c->_muscles_tot*sizeof(int16_t));
+  // With a negative threshold, neurons resting at zero are
+  // over it without receiving any input, so every neuron
+  // has to be checked
+  if(!(c->_mode & CTM_MODE_EVENT_DRIVEN) || c->_params.threshold < 0) {
+    c->_kernels->above(c->_neuron_current, c->_neurons_tot, c->_params.threshold, c->_discharged);
+    return;
+  }
 
-  // Allocate metastate array
-  c->_meta = malloc(c->_neurons_tot*sizeof(uint8_t));
+  // Only neurons that received input last tick can be
+  // over threshold
+  ctm_bitset_clear(c->_discharged, words);
 
-  // Set up pointers for public interface members
-  c->neuron_state = c->_neuron_current;
-  c->muscle_state = c->_muscle_current;
+  for(CtmId w = 0; w < words; w++) {
+    CtmBitWord bits = c->_frontier[w];
 
-  // Initialize arrays to zero
-  memset(c->_neuron_current, 0, c->_neurons_tot*sizeof(c->_neuron_current[0]));
-  memset(c->_neuron_next, 0, c->_neurons_tot*sizeof(c->_neuron_next[0]));
-  memset(c->_muscle_current, 0, c->_muscles_tot*sizeof(c->_muscle_current[0]));
-  memset(c->_muscle_next, 0, c->_muscles_tot*sizeof(c->_muscle_next[0]));
-  memset(c->_meta, 0, c->_neurons_tot*sizeof(c->_meta[0]));
+    while(bits) {
+      const CtmId id = w*CTM_BITS_PER_WORD + ctm_bitword_lowest(bits);
+      bits &= bits - 1;
+
+      if(ctm_get_current_state(c, id) > c->_params.threshold) {
+        ctm_meta_flag_discharge(c, id, 1);
+      }
+    }
+  }
 }
 
-// Propagate each neuron connection weight into the next state
-void ctm_ping_neuron(Connectome* const c, const uint16_t id) {
-  const uint16_t address = READ_WORD(NEURAL_ROM, id + 1);
-  const uint16_t len = READ_WORD(NEURAL_ROM, id + 2) - READ_WORD(NEURAL_ROM, id + 1);
-  
-  for(int8_t i = 0; i < len; i++) {
-    NeuronConnection neuron_conn = parse_rom_word(READ_WORD(NEURAL_ROM, address + i));
+// Discharge flagged neurons in id order, each scattering
+// into its targets
+static void ctm_push_discharges(Connectome* const c) {
+  const CtmId words = CTM_BITSET_WORDS(c->_neurons_tot);
 
-    ctm_add_to_next_state(c, neuron_conn.id, neuron_conn.weight);
+  for(CtmId w = 0; w < words; w++) {
+    CtmBitWord bits = c->_discharged[w];
+
+    while(bits) {
+      const CtmId id = w*CTM_BITS_PER_WORD + ctm_bitword_lowest(bits);
+      bits &= bits - 1;
+
+      ctm_discharge_neuron(c, id);
+    }
   }
 }
 
-// Propagate connections and set state to zero (i.e. simulate a neuron
-// discharge)
-void ctm_discharge_neuron(Connectome* const c, const uint16_t id) {
-  ctm_ping_neuron(c, id);
-  ctm_set_next_state(c, id, 0);
+// Have muscles [from, to) (by cell id) gather from their
+// flagged inputs (muscles don't saturate, so input order
+// doesn't matter)
+static void ctm_pull_muscles(Connectome* const c, const CtmId from, const CtmId to) {
+  const CtmReverseTable* const r = c->_reverse;
+  const CtmBitWord* const fired = c->_discharged;
+
+  for(CtmId id = from; id < to; id++) {
+    const uint32_t end = r->col_offset[id + 1];
+    int16_t val = c->_muscle_next[id - c->_neurons_tot];
+
+    for(uint32_t i = r->col_offset[id]; i < end; i++) {
+      if(ctm_bitset_get(fired, r->source[i])) {
+        val = (int16_t)(val + r->weight[i]);
+        CTM_COUNT(synaptic_events, 1);
+      }
+    }
+
+    c->_muscle_next[id - c->_neurons_tot] = val;
+  }
 }
 
-// Complete one cycle ('tick') of the nematode neural system;
-// accepts an array of neurons to stimulate and the length of
-// that list---otherwise NULL, 0
-void ctm_neural_cycle(Connectome* const c, const uint16_t* stim_neuron, const uint16_t len) {
+// Have neurons [from, to) gather from their flagged inputs
+// into the tick's sums (deferred saturation, where the
+// order doesn't matter either)
+//
+// As in ctm_push_discharges, a discharging neuron loses
+// what it received before its own discharge: the stimulus,
+// and inputs from neurons up to its own id
+static void ctm_pull_neurons_deferred(Connectome* const c, const CtmId from, const CtmId to) {
+  const CtmReverseTable* const r = c->_reverse;
+  const CtmBitWord* const fired = c->_discharged;
 
-  // Iterate through list of neurons to
-  // stimulate this tick, if any
-  if(stim_neuron != NULL) {
-    for(uint16_t i = 0; i < len; i++) {
-      uint16_t id = stim_neuron[i];
-      ctm_ping_neuron(c, id);
+  for(CtmId id = from; id < to; id++) {
+    const uint32_t end = r->col_offset[id + 1];
+    uint32_t i = r->col_offset[id];
+    CtmSum sum = 0;
+    uint8_t touched = 0;
+
+    if(ctm_bitset_get(fired, id)) {
+      for(; i < end && r->source[i] <= id; i++) {
+        if(ctm_bitset_get(fired, r->source[i])) {
+          CTM_COUNT(synaptic_events, 1);
+          touched = 1;
+        }
+      }
+
+      c->_neuron_next[id] = 0;
+      c->_neuron_acc[id] = 0;
+    }
+
+    for(; i < end; i++) {
+      if(ctm_bitset_get(fired, r->source[i])) {
+        sum += r->weight[i];
+        CTM_COUNT(synaptic_events, 1);
+        touched = 1;
+      }
+    }
+
+    if(touched) {
+      c->_neuron_acc[id] += sum;
+      ctm_bitset_set(c->_touched, id);
     }
   }
+}
 
-  // Discharge any neurons over threshold
-  for(uint16_t i = 0; i < c->_neurons_tot; i++) {
-    if(ctm_get_current_state(c, i) > THRESHOLD) {
-      ctm_discharge_neuron(c, i);
-      ctm_meta_flag_discharge(c, i, 1);
+// Have neurons [from, to) gather from their flagged inputs;
+// each cell is written by itself alone, so cells can be
+// processed in any order
+//
+// Inputs are sorted by source, and a discharging neuron is
+// zeroed right after its own input (if any) is applied, so
+// every neuron sees the same sequence of clamped adds as in
+// ctm_push_discharges
+CTM_INLINE void ctm_pull_neurons_in(Connectome* const c, const CtmId from, const CtmId to, const int8_t lo, const int8_t hi) {
+  const CtmReverseTable* const r = c->_reverse;
+  const CtmBitWord* const fired = c->_discharged;
+
+  for(CtmId id = from; id < to; id++) {
+    const uint32_t end = r->col_offset[id + 1];
+    uint32_t i = r->col_offset[id];
+    uint8_t touched = 0;
+
+    CtmSum val = c->_neuron_next[id];
+
+    for(; i < end && r->source[i] <= id; i++) {
+      if(ctm_bitset_get(fired, r->source[i])) {
+        val = val + r->weight[i];
+        CTM_COUNT(synaptic_events, 1);
+        CTM_COUNT(saturations, val > hi || val < lo);
+        val = ctm_clamp(val, lo, hi);
+        touched = 1;
+      }
     }
-    else {
-      ctm_meta_flag_discharge(c, i, 0);
+
+    if(ctm_bitset_get(fired, id)) {
+      val = 0;
+    }
+
+    for(; i < end; i++) {
+      if(ctm_bitset_get(fired, r->source[i])) {
+        val = val + r->weight[i];
+        CTM_COUNT(synaptic_events, 1);
+        CTM_COUNT(saturations, val > hi || val < lo);
+        val = ctm_clamp(val, lo, hi);
+        touched = 1;
+      }
+    }
+
+    c->_neuron_next[id] = (int8_t)val;
+
+    if(touched) {
+      ctm_bitset_set(c->_touched, id);
+    }
+  }
+}
+
+// Discharge flagged neurons by having neurons [from, to)
+// and muscles [muscle_from, muscle_to) gather from their
+// flagged inputs
+static void ctm_pull_range(Connectome* const c, const CtmId from, const CtmId to, const CtmId muscle_from, const CtmId muscle_to) {
+  if(c->_mode & CTM_MODE_DEFERRED_SATURATION) {
+    ctm_pull_neurons_deferred(c, from, to);
+  }
+  else if(c->_clamp_default) {
+    ctm_pull_neurons_in(c, from, to, -128, 127);
+  }
+  else {
+    ctm_pull_neurons_in(c, from, to, c->_params.neuron_min, c->_params.neuron_max);
+  }
+
+  ctm_pull_muscles(c, muscle_from, muscle_to);
+}
+
+static void ctm_pull_discharges(Connectome* const c) {
+  ctm_pull_range(c, 0, c->_neurons_tot, c->_neurons_tot, c->_reverse->cols);
+}
+
+#ifdef CTM_PARALLEL
+//
+// Discharges propagated by several threads
+//
+// Each thread pulls the inputs of its own share of the
+// cells, as in ctm_pull_discharges, so it writes nothing
+// the others read or write: neuron shares start on a word
+// of the touched bitset, and shares are split to take
+// about as many inputs each
+//
+
+typedef struct CtmParallel {
+  CtmPool pool;
+
+  // First neuron and first muscle of each thread's share
+  // (threads + 1 entries)
+  CtmId* neuron_start;
+  CtmId* muscle_start;
+
+#ifdef CTM_STATS
+  // Counts of each thread's share of the last tick
+  CtmStats* stats;
+#endif
+} CtmParallel;
+
+// Split cells [first, end) into the given number of shares
+// of about equal cost (inputs plus one per cell), starting
+// on multiples of unit cells from first
+static void ctm_parallel_split(const CtmReverseTable* const r, const CtmId first, const CtmId end, const CtmId unit, const uint16_t shares, CtmId* const start) {
+  const uint64_t total = (uint64_t)(r->col_offset[end] - r->col_offset[first]) + (end - first);
+  CtmId at = first;
+
+  start[0] = first;
+
+  for(uint16_t k = 1; k < shares; k++) {
+    const uint64_t target = total*k/shares;
+
+    while(at < end && (uint64_t)(r->col_offset[at] - r->col_offset[first]) + (at - first) < target) {
+      at = end - at > unit ? at + unit : end;
     }
+
+    start[k] = at;
   }
 
-  ctm_meta_handle_idle_neurons(c);
-  ctm_iterate_state(c);
+  start[shares] = end;
 }
 
-// Utility functions
+// Release a thread pool and its shares (the pool only if
+// it was started)
+static void ctm_parallel_free(CtmParallel* const p, const uint8_t started) {
+  if(p == NULL) {
+    return;
+  }
+
+  if(started) {
+    ctm_pool_free(&p->pool);
+  }
+
+  free(p->neuron_start);
+  free(p->muscle_start);
+
+#ifdef CTM_STATS
+  free(p->stats);
+#endif
+
+  free(p);
+}
+
+// Pull one thread's share
+static void ctm_parallel_pull(void* arg, const uint16_t k) {
+  Connectome* const c = arg;
+  const CtmParallel* const p = c->_parallel;
+
+#ifdef CTM_STATS
+  // Counts go into a copy of the connectome, and are added
+  // up once every thread is done
+  Connectome view = *c;
+  memset(&view._stats_tick, 0, sizeof(CtmStats));
+
+  ctm_pull_range(&view, p->neuron_start[k], p->neuron_start[k + 1], p->muscle_start[k], p->muscle_start[k + 1]);
+
+  p->stats[k] = view._stats_tick;
+#else
+  ctm_pull_range(c, p->neuron_start[k], p->neuron_start[k + 1], p->muscle_start[k], p->muscle_start[k + 1]);
+#endif
+}
+
+static void ctm_parallel_pull_discharges(Connectome* const c) {
+  CtmParallel* const p = c->_parallel;
+
+  ctm_pool_run(&p->pool, ctm_parallel_pull, c);
+
+#ifdef CTM_STATS
+  for(uint16_t k = 0; k < p->pool.threads; k++) {
+    c->_stats_tick.synaptic_events += p->stats[k].synaptic_events;
+    c->_stats_tick.saturations += p->stats[k].saturations;
+  }
+#endif
+}
+#endif
+
+// Propagate the flagged discharges
+static void ctm_propagate_discharges(Connectome* const c) {
+  // Pulling visits every cell, even if nothing fired
+  if(!ctm_bitset_any(c->_discharged, CTM_BITSET_WORDS(c->_neurons_tot))) {
+    return;
+  }
+
+#ifdef CTM_PARALLEL
+  if(c->_parallel != NULL) {
+    ctm_parallel_pull_discharges(c);
+    return;
+  }
+#endif
+
+  if(c->_mode & CTM_MODE_PULL) {
+    ctm_pull_discharges(c);
+  }
+  else {
+    ctm_push_discharges(c);
+  }
+}
+
+// Clamp the summed inputs of every touched neuron into its
+// next state (deferred saturation)
+CTM_INLINE void ctm_saturate_in(Connectome* const c, const int8_t lo, const int8_t hi) {
+  const CtmId words = CTM_BITSET_WORDS(c->_neurons_tot);
+
+  for(CtmId w = 0; w < words; w++) {
+    CtmBitWord bits = c->_touched[w];
+
+    while(bits) {
+      const CtmId id = w*CTM_BITS_PER_WORD + ctm_bitword_lowest(bits);
+      bits &= bits - 1;
+
+      const CtmSum val = c->_neuron_next[id] + c->_neuron_acc[id];
+
+      CTM_COUNT(saturations, val > hi || val < lo);
+      c->_neuron_next[id] = ctm_clamp(val, lo, hi);
+      c->_neuron_acc[id] = 0;
+    }
+  }
+}
+
+static void ctm_saturate(Connectome* const c) {
+  if(c->_clamp_default) {
+    ctm_saturate_in(c, -128, 127);
+  }
+  else {
+    ctm_saturate_in(c, c->_params.neuron_min, c->_params.neuron_max);
+  }
+}
+#endif
+
+//
+// State block layout
+//
+
+// Reserve len bytes of the block (from base, or nowhere if
+// it is only being measured), keeping arrays aligned
+static void* ctm_carve(uint8_t* const base, size_t* const used, const size_t len) {
+  void* p = base != NULL ? base + *used : NULL;
+
+  *used += (len + CTM_ALIGN - 1) & ~(size_t)(CTM_ALIGN - 1);
+
+  return p;
+}
+
+// Point every state array into the block at base (NULL to
+// just measure it); returns the block's size
+static size_t ctm_layout(Connectome* const c, uint8_t* const base) {
+  const CtmId n = c->_neurons_tot;
+  const CtmId m = c->_muscles_tot;
+  size_t used = 0;
+
+  c->_neuron_current = ctm_carve(base, &used, n*sizeof(int8_t));
+  c->_neuron_next = ctm_carve(base, &used, n*sizeof(int8_t));
+  c->_muscle_current = ctm_carve(base, &used, m*sizeof(int16_t));
+  c->_muscle_next = ctm_carve(base, &used, m*sizeof(int16_t));
+
+#ifdef CTM_FRONTIER
+  const size_t bits = CTM_BITSET_WORDS(n)*sizeof(CtmBitWord);
+
+  c->_touched = ctm_carve(base, &used, bits);
+  c->_frontier = ctm_carve(base, &used, bits);
+  c->_neuron_acc = ctm_carve(base, &used, n*sizeof(CtmSum));
+  c->_discharged = ctm_carve(base, &used, bits);
+  c->_changed = ctm_carve(base, &used, bits);
+  c->_overdue = ctm_carve(base, &used, bits);
+
+  c->_idle_slot = ctm_carve(base, &used, n*sizeof(uint8_t));
+  c->_wheel_next = ctm_carve(base, &used, ((size_t)n + CTM_WHEEL_SLOTS)*sizeof(CtmId));
+  c->_wheel_prev = ctm_carve(base, &used, ((size_t)n + CTM_WHEEL_SLOTS)*sizeof(CtmId));
+#else
+  c->_meta = ctm_carve(base, &used, n*sizeof(uint8_t));
+#endif
+
+  return used;
+}
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+//
+// Registered stimuli
+//
+// A stimulus is compiled into the sum of the weights it
+// adds to each cell it reaches. Pinging clamps a neuron
+// after every connection, but a run of clamped additions
+// x -> clamp(x + w, lo, hi) always amounts to a single
+// addition of their sum clamped to a narrower range, which
+// is worked out for each neuron target (and again whenever
+// the clamp range changes). Applying a stimulus is then one
+// addition per target, and one OR per word of the touched
+// bitset.
+//
+
+typedef struct CtmStimulusCache {
+  // Neurons pinged, in order, and the number of
+  // connections they have in all
+  CtmId* ids;
+  CtmId len;
+  uint32_t events;
+
+  // Cells reached, in id order (neurons, then muscles),
+  // and the sum of the weights added to each
+  CtmId* target;
+  int32_t* sum;
+  uint32_t targets;
+  uint32_t neurons;
+
+  // Weights added to each neuron target, in the order
+  // pinging adds them: target i's run from weight[offset[i]]
+  // to weight[offset[i + 1] - 1]
+  uint32_t* offset;
+  CtmWeight* weight;
+
+  // Range each neuron target's sum is clamped to, for
+  // states clamped to [range_lo, range_hi]
+  int8_t* lo;
+  int8_t* hi;
+  int8_t range_lo;
+  int8_t range_hi;
+
+  // Words of the touched bitset holding neuron targets, and
+  // the targets' bits in each
+  CtmId* touch_word;
+  CtmBitWord* touch_mask;
+  CtmId touch_words;
+} CtmStimulusCache;
+
+static void ctm_stimulus_cache_free(CtmStimulusCache* const s) {
+  free(s->ids);
+  free(s->target);
+  free(s->sum);
+  free(s->offset);
+  free(s->weight);
+  free(s->lo);
+  free(s->hi);
+  free(s->touch_word);
+  free(s->touch_mask);
+}
+
+static void ctm_stimuli_free(Connectome* const c) {
+  for(uint16_t i = 0; i < c->_stimuli_len; i++) {
+    ctm_stimulus_cache_free(&c->_stimuli[i]);
+  }
+
+  free(c->_stimuli);
+  c->_stimuli = NULL;
+  c->_stimuli_len = 0;
+}
+
+// Work out the range each neuron target's sum is clamped
+// to, for states clamped to [lo, hi]
+static void ctm_stimulus_bounds(CtmStimulusCache* const s, const int8_t lo, const int8_t hi) {
+  for(uint32_t i = 0; i < s->neurons; i++) {
+    // Next states start out in the int8 range, which the
+    // first addition (there is at least one) narrows
+    int32_t a = -128;
+    int32_t b = 127;
+
+    for(uint32_t j = s->offset[i]; j < s->offset[i + 1]; j++) {
+      a = ctm_clamp(a + s->weight[j], lo, hi);
+      b = ctm_clamp(b + s->weight[j], lo, hi);
+    }
+
+    s->lo[i] = (int8_t)a;
+    s->hi[i] = (int8_t)b;
+  }
+
+  s->range_lo = lo;
+  s->range_hi = hi;
+}
+
+// Compile a list of neurons into a stimulus; returns 0 if
+// memory runs out
+static uint8_t ctm_stimulus_compile(Connectome* const c, CtmStimulusCache* const s, const CtmId* ids, const CtmId len) {
+  const CtmSynapseTable* const t = c->_synapses;
+  const CtmId cells = c->_neurons_tot + c->_muscles_tot;
+
+  memset(s, 0, sizeof(*s));
+
+  // Connections reaching each cell, then (for cells
+  // reached) the cell's place among the targets
+  uint32_t* slot = calloc(cells, sizeof(uint32_t));
+  s->ids = malloc(((size_t)len + 1)*sizeof(CtmId));
+
+  if(slot == NULL || s->ids == NULL) {
+    free(slot);
+    return 0;
+  }
+
+  if(len > 0) {
+    memcpy(s->ids, ids, (size_t)len*sizeof(CtmId));
+  }
+
+  s->len = len;
+
+  for(CtmId i = 0; i < len; i++) {
+    if(ids[i] >= t->rows) {
+      continue;
+    }
+
+    for(uint32_t j = t->row_offset[ids[i]]; j < t->row_offset[ids[i] + 1]; j++) {
+      slot[t->target[j]]++;
+      s->events++;
+    }
+  }
+
+  for(CtmId id = 0; id < cells; id++) {
+    s->targets += slot[id] > 0;
+    s->neurons += slot[id] > 0 && id < c->_neurons_tot;
+  }
+
+  s->target = malloc(((size_t)s->targets + 1)*sizeof(CtmId));
+  s->sum = calloc((size_t)s->targets + 1, sizeof(int32_t));
+  s->offset = malloc(((size_t)s->neurons + 1)*sizeof(uint32_t));
+  s->weight = malloc(((size_t)s->events + 1)*sizeof(CtmWeight));
+  s->lo = malloc((size_t)s->neurons + 1);
+  s->hi = malloc((size_t)s->neurons + 1);
+  s->touch_word = malloc(((size_t)s->neurons + 1)*sizeof(CtmId));
+  s->touch_mask = calloc((size_t)s->neurons + 1, sizeof(CtmBitWord));
+
+  if(s->target == NULL || s->sum == NULL || s->offset == NULL || s->weight == NULL ||
+      s->lo == NULL || s->hi == NULL || s->touch_word == NULL || s->touch_mask == NULL) {
+    free(slot);
+    ctm_stimulus_cache_free(s);
+    return 0;
+  }
+
+  // Targets in id order, with room for each neuron
+  // target's weights
+  uint32_t n = 0;
+  uint32_t weights = 0;
+
+  for(CtmId id = 0; id < cells; id++) {
+    if(slot[id] == 0) {
+      continue;
+    }
+
+    if(id < c->_neurons_tot) {
+      s->offset[n] = weights;
+      weights += slot[id];
+    }
+
+    s->target[n] = id;
+    slot[id] = n++;
+  }
+
+  s->offset[s->neurons] = weights;
+
+  // Weights in the order pinging adds them
+  uint32_t* fill = malloc(((size_t)s->neurons + 1)*sizeof(uint32_t));
+
+  if(fill == NULL) {
+    free(slot);
+    ctm_stimulus_cache_free(s);
+    return 0;
+  }
+
+  memcpy(fill, s->offset, (size_t)s->neurons*sizeof(uint32_t));
+
+  for(CtmId i = 0; i < len; i++) {
+    if(ids[i] >= t->rows) {
+      continue;
+    }
+
+    for(uint32_t j = t->row_offset[ids[i]]; j < t->row_offset[ids[i] + 1]; j++) {
+      const uint32_t k = slot[t->target[j]];
+
+      s->sum[k] += t->weight[j];
+
+      if(k < s->neurons) {
+        s->weight[fill[k]++] = t->weight[j];
+      }
+    }
+  }
+
+  free(fill);
+  free(slot);
+
+  // Touched bits, a word at a time
+  for(uint32_t i = 0; i < s->neurons; i++) {
+    const CtmId word = s->target[i]/CTM_BITS_PER_WORD;
+
+    if(s->touch_words == 0 || s->touch_word[s->touch_words - 1] != word) {
+      s->touch_word[s->touch_words++] = word;
+    }
+
+    s->touch_mask[s->touch_words - 1] |= (CtmBitWord)1 << (s->target[i] % CTM_BITS_PER_WORD);
+  }
+
+  ctm_stimulus_bounds(s, c->_params.neuron_min, c->_params.neuron_max);
+
+  return 1;
+}
+
+// Register a list of neurons to stimulate; returns its
+// handle, or zero if an id is out of range or memory runs
+// out
+CtmStimulus ctm_register_stimulus(Connectome* const c, const CtmId* ids, const CtmId len) {
+  if(c->_stimuli_len == UINT16_MAX) {
+    return 0;
+  }
+
+  for(CtmId i = 0; i < len; i++) {
+    if(ids[i] >= c->_neurons_tot + c->_muscles_tot) {
+      return 0;
+    }
+  }
+
+  CtmStimulusCache* const grown = realloc(c->_stimuli, ((size_t)c->_stimuli_len + 1)*sizeof(CtmStimulusCache));
+
+  if(grown == NULL) {
+    return 0;
+  }
+
+  c->_stimuli = grown;
+
+  if(!ctm_stimulus_compile(c, &c->_stimuli[c->_stimuli_len], ids, len)) {
+    return 0;
+  }
+
+  return ++c->_stimuli_len;
+}
+
+// Add a registered stimulus into the next state
+static void ctm_stimulus_apply(Connectome* const c, CtmStimulusCache* const s) {
+  const uint8_t deferred = (c->_mode & CTM_MODE_DEFERRED_SATURATION) != 0;
+  const uint8_t fast = (c->_mode & CTM_MODE_FAST_STIMULUS) != 0;
+
+#ifdef CTM_STATS
+  // Saturations are counted connection by connection, as
+  // the stimulus is pinged
+  if(!deferred && !fast) {
+    for(CtmId i = 0; i < s->len; i++) {
+      ctm_ping_neuron(c, s->ids[i]);
+    }
+
+    CTM_COUNT(stimuli, s->len);
+    return;
+  }
+#endif
+
+  CTM_COUNT(stimuli, s->len);
+  CTM_COUNT(synaptic_events, s->events);
+
+  if(deferred) {
+    for(uint32_t i = 0; i < s->neurons; i++) {
+      c->_neuron_acc[s->target[i]] += s->sum[i];
+    }
+  }
+  else if(fast) {
+    const int8_t lo = c->_params.neuron_min;
+    const int8_t hi = c->_params.neuron_max;
+
+    for(uint32_t i = 0; i < s->neurons; i++) {
+      const int32_t val = c->_neuron_next[s->target[i]] + s->sum[i];
+
+      CTM_COUNT(saturations, val > hi || val < lo);
+      c->_neuron_next[s->target[i]] = val > hi ? hi : (val < lo ? lo : (int8_t)val);
+    }
+  }
+  else {
+    if(s->range_lo != c->_params.neuron_min || s->range_hi != c->_params.neuron_max) {
+      ctm_stimulus_bounds(s, c->_params.neuron_min, c->_params.neuron_max);
+    }
+
+    for(uint32_t i = 0; i < s->neurons; i++) {
+      const int32_t val = c->_neuron_next[s->target[i]] + s->sum[i];
+
+      c->_neuron_next[s->target[i]] = val > s->hi[i] ? s->hi[i] : (val < s->lo[i] ? s->lo[i] : (int8_t)val);
+    }
+  }
+
+  for(uint32_t i = s->neurons; i < s->targets; i++) {
+    int16_t* const muscle = &c->_muscle_next[s->target[i] - c->_neurons_tot];
+    *muscle = (int16_t)(*muscle + s->sum[i]);
+  }
+
+  for(CtmId w = 0; w < s->touch_words; w++) {
+    c->_touched[s->touch_word[w]] |= s->touch_mask[w];
+  }
+}
+#endif
+
+//
+// Functions that provide primary interface to
+// connectome emulation
+//
+
+// Size in bytes of the block holding a simulation's state
+size_t ctm_required_size(const CtmNetwork* const net) {
+  Connectome c;
+
+  c._neurons_tot = net->neurons;
+  c._muscles_tot = net->cells - net->neurons;
+
+  return ctm_layout(&c, NULL);
+}
+
+// Function for initializing connectome struct to simulate
+// the given network (which must outlive it); returns 0 if
+// its state can't be allocated
+uint8_t ctm_init(Connectome* const c, const CtmNetwork* const net) {
+  const size_t size = ctm_required_size(net);
+
+#ifdef ARDUINO_AVR_UNO
+  void* block = malloc(size);
+#else
+  void* block;
+
+  if(posix_memalign(&block, CTM_ALIGN, size) != 0) {
+    block = NULL;
+  }
+#endif
+
+  if(block == NULL) {
+    return 0;
+  }
+
+  ctm_init_in_buffer(c, net, block, size);
+  c->_block = block;
+
+  return 1;
+}
+
+// Initialize a connectome struct with its state in the
+// given block; returns 0 if the block is misaligned or too
+// small
+uint8_t ctm_init_in_buffer(Connectome* const c, const CtmNetwork* const net, void* block, const size_t size) {
+  if((uintptr_t)block % CTM_ALIGN != 0 || size < ctm_required_size(net)) {
+    return 0;
+  }
+
+  c->_network = net;
+  c->_block = NULL;
+
+#ifdef CTM_PROFILE
+  c->_profile = NULL;
+#endif
+
+#ifdef CTM_STATS
+  memset(&c->_stats_tick, 0, sizeof(CtmStats));
+  ctm_stats_reset(c);
+#endif
+
+  // Set number of neuron type cells
+  c->_neurons_tot = net->neurons;
+  c->_muscles_tot = net->cells - c->_neurons_tot;
+
+  // Lay out and zero every state array
+  memset(block, 0, ctm_layout(c, block));
+
+  // Use compiled-in parameters until told otherwise
+  ctm_default_params(&c->_params);
+  c->_clamp_default = 1;
+
+  // Set up pointers for public interface members
+  c->neuron_state = c->_neuron_current;
+  c->muscle_state = c->_muscle_current;
+
+#ifdef CTM_SYNAPSE_TABLE
+  // Connections are decoded once per network
+  c->_synapses = &net->_synapses;
+#endif
+
+#ifdef CTM_FRONTIER
+  c->_reverse = &net->_reverse;
+
+#ifdef CTM_PARALLEL
+  c->_parallel = NULL;
+#endif
+
+#ifdef CTM_STIMULUS_CACHE
+  c->_stimuli = NULL;
+  c->_stimuli_len = 0;
+#endif
+#endif
+
+#ifdef CTM_FRONTIER
+  c->_mode = 0;
+
+  c->_kernels = ctm_kernels();
+
+  // No neuron is scheduled on the idle timing wheel until
+  // its state first changes
+  c->_wheel_slot = 0;
+
+  // Every count starts at zero as of the (notional) last
+  // tick, which is the slot before slot zero
+  for(CtmId i = 0; i < c->_neurons_tot; i++) {
+    c->_idle_slot[i] = c->_params.max_idle;
+  }
+
+  c->_overdue_any = 0;
+
+  ctm_wheel_build(c, c->_params.max_idle);
+#endif
+
+  return 1;
+}
+
+// Release the state allocated by ctm_init, stop any
+// threads of its own and drop registered stimuli
+void ctm_free(Connectome* const c) {
+#if defined(CTM_FRONTIER) && defined(CTM_PARALLEL)
+  ctm_parallel_free(c->_parallel, 1);
+  c->_parallel = NULL;
+#endif
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+  ctm_stimuli_free(c);
+#endif
+
+  free(c->_block);
+  c->_block = NULL;
+}
+
+// Fill in the compiled-in parameters (THRESHOLD, MAX_IDLE
+// and the full int8 range)
+void ctm_default_params(CtmParams* const p) {
+  p->threshold = THRESHOLD;
+  p->max_idle = MAX_IDLE;
+  p->neuron_min = -128;
+  p->neuron_max = 127;
+}
+
+// Set simulation parameters; returns 0 and leaves the
+// parameters as they were if they are invalid
+uint8_t ctm_set_params(Connectome* const c, const CtmParams* const p) {
+  // Discharges and idle resets set neurons to zero
+  if(p->neuron_min > 0 || p->neuron_max < 0) {
+    return 0;
+  }
+
+#ifdef CTM_FRONTIER
+  const uint8_t old_max_idle = c->_params.max_idle;
+#else
+  // Idle counts are kept in seven bits of _meta
+  if(p->max_idle > 126) {
+    return 0;
+  }
+#endif
+
+#ifdef CTM_FRONTIER
+  // Neurons that were under the old threshold but are over
+  // a lower one haven't necessarily received any input, so
+  // every neuron is on the next frontier
+  if(p->threshold < c->_params.threshold) {
+    ctm_bitset_fill(c->_frontier, c->_neurons_tot);
+  }
+#endif
+
+  c->_params = *p;
+  c->_clamp_default = (p->neuron_min == -128 && p->neuron_max == 127);
+
+#ifdef CTM_FRONTIER
+  if(p->max_idle != old_max_idle) {
+    ctm_wheel_build(c, old_max_idle);
+  }
+#endif
+
+  return 1;
+}
+
+#ifdef CTM_PROFILE
+// Start adding each tick's phase timings to the given
+// profile (NULL stops)
+void ctm_set_profile(Connectome* const c, CtmProfile* const p) {
+  c->_profile = p;
+}
+#endif
+
+#ifdef CTM_STATS
+// Close the current tick's counts: they become the last
+// tick's and are added to the totals
+static void ctm_stats_end_tick(Connectome* const c) {
+  CtmStats* const t = &c->_stats_tick;
+  CtmStats* const total = &c->_stats_total;
+
+  t->ticks = 1;
+
+  total->ticks++;
+  total->stimuli += t->stimuli;
+  total->discharges += t->discharges;
+  total->synaptic_events += t->synaptic_events;
+  total->saturations += t->saturations;
+  total->idle_resets += t->idle_resets;
+
+  c->_stats_last = *t;
+  memset(t, 0, sizeof(CtmStats));
+}
+
+// Copy out the counts summed over every tick since
+// ctm_init or ctm_stats_reset, and those of the last tick
+// alone (either may be NULL)
+void ctm_stats(const Connectome* const c, CtmStats* const total, CtmStats* const last) {
+  if(total != NULL) {
+    *total = c->_stats_total;
+  }
+
+  if(last != NULL) {
+    *last = c->_stats_last;
+  }
+}
+
+// Zero the counts
+void ctm_stats_reset(Connectome* const c) {
+  memset(&c->_stats_last, 0, sizeof(CtmStats));
+  memset(&c->_stats_total, 0, sizeof(CtmStats));
+}
+#endif
+
+#ifdef CTM_SNAPSHOT
+#ifdef CTM_FRONTIER
+// Pack the first n bits of a bitset into bytes, low bit
+// first
+static void ctm_pack_bits(uint8_t* const out, const CtmBitWord* const bits, const CtmId n) {
+  const CtmId len = (n + 7)/8;
+
+  for(CtmId i = 0; i < len; i++) {
+    out[i] = (uint8_t)(bits[i/8] >> (8*(i % 8)));
+  }
+
+  if(n % 8 != 0) {
+    out[len - 1] &= (1 << (n % 8)) - 1;
+  }
+}
+#endif
+
+// Size in bytes of a snapshot of a simulation's state
+size_t ctm_state_size(const Connectome* const c) {
+  const size_t n = c->_neurons_tot;
+
+  return sizeof(CtmStateHeader) + 2*n + c->_muscles_tot*sizeof(int16_t) + 2*((n + 7)/8);
+}
+
+// Write a snapshot of the state between ticks (including
+// its parameters) into the given buffer; returns 0 if the
+// buffer is too small
+uint8_t ctm_save_state(const Connectome* const c, void* buf, const size_t size) {
+  if(size < ctm_state_size(c)) {
+    return 0;
+  }
+
+  const CtmId n = c->_neurons_tot;
+  const size_t bit_bytes = (n + 7)/8;
+
+  CtmStateHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, CTM_STATE_MAGIC, 4);
+  h.version = CTM_STATE_VERSION;
+  h.cells = n + c->_muscles_tot;
+  h.neurons = n;
+  h.network_hash = ctm_network_hash(c->_network);
+  h.threshold = c->_params.threshold;
+  h.max_idle = c->_params.max_idle;
+  h.neuron_min = c->_params.neuron_min;
+  h.neuron_max = c->_params.neuron_max;
+
+  uint8_t* p = buf;
+  memcpy(p, &h, sizeof(h));
+  p += sizeof(h);
+
+  // Between ticks the next neuron states match the current
+  // ones, and the next muscle states are all zero
+  memcpy(p, c->_neuron_current, n);
+  p += n;
+  memcpy(p, c->_muscle_current, c->_muscles_tot*sizeof(int16_t));
+  p += c->_muscles_tot*sizeof(int16_t);
+
+  uint8_t* const idle = p;
+  uint8_t* const discharged = idle + n;
+  uint8_t* const frontier = discharged + bit_bytes;
+
+  // Every neuron's count is saved, those at zero included:
+  // a neuron that leaves zero carries its count over
+  for(CtmId id = 0; id < n; id++) {
+#ifdef CTM_FRONTIER
+    idle[id] = ctm_idle_count(c, id, c->_params.max_idle);
+#else
+    idle[id] = c->_meta[id] & 0b01111111;
+#endif
+  }
+
+#ifdef CTM_FRONTIER
+  ctm_pack_bits(discharged, c->_discharged, n);
+  ctm_pack_bits(frontier, c->_frontier, n);
+#else
+  memset(discharged, 0, 2*bit_bytes);
+
+  for(CtmId id = 0; id < n; id++) {
+    if(c->_meta[id] & 0b10000000) {
+      discharged[id/8] |= 1 << (id % 8);
+    }
+
+    // Without a frontier, any neuron could be over
+    // threshold
+    frontier[id/8] |= 1 << (id % 8);
+  }
+#endif
+
+  return 1;
+}
+
+// Restore a snapshot, after which the simulation carries
+// on exactly as the one it was taken of would have; returns
+// 0 and leaves the state as it was if the buffer isn't a
+// snapshot of a simulation of the same network
+uint8_t ctm_load_state(Connectome* const c, const void* buf, const size_t size) {
+  const CtmId n = c->_neurons_tot;
+  const size_t bit_bytes = (n + 7)/8;
+
+  CtmStateHeader h;
+
+  if(size < sizeof(h)) {
+    return 0;
+  }
+
+  memcpy(&h, buf, sizeof(h));
+
+  if(memcmp(h.magic, CTM_STATE_MAGIC, 4) != 0 || h.version != CTM_STATE_VERSION) {
+    return 0;
+  }
+
+  if(h.neurons != n || h.cells != n + c->_muscles_tot || size < ctm_state_size(c)) {
+    return 0;
+  }
+
+  if(h.neuron_min > 0 || h.neuron_max < 0) {
+    return 0;
+  }
+
+#ifndef CTM_FRONTIER
+  // Idle counts are kept in seven bits of _meta
+  if(h.max_idle > 126) {
+    return 0;
+  }
+#endif
+
+  if(h.network_hash != ctm_network_hash(c->_network)) {
+    return 0;
+  }
+
+  c->_params.threshold = h.threshold;
+  c->_params.max_idle = h.max_idle;
+  c->_params.neuron_min = h.neuron_min;
+  c->_params.neuron_max = h.neuron_max;
+  c->_clamp_default = (h.neuron_min == -128 && h.neuron_max == 127);
+
+  const uint8_t* p = (const uint8_t*)buf + sizeof(h);
+
+  memcpy(c->_neuron_current, p, n);
+  memcpy(c->_neuron_next, p, n);
+  p += n;
+  memcpy(c->_muscle_current, p, c->_muscles_tot*sizeof(int16_t));
+  memset(c->_muscle_next, 0, c->_muscles_tot*sizeof(int16_t));
+  p += c->_muscles_tot*sizeof(int16_t);
+
+  const uint8_t* const idle = p;
+  const uint8_t* const discharged = idle + n;
+  const uint8_t* const frontier = discharged + bit_bytes;
+
+#ifdef CTM_FRONTIER
+  const CtmId words = CTM_BITSET_WORDS(n);
+
+  ctm_bitset_clear(c->_touched, words);
+  ctm_bitset_clear(c->_frontier, words);
+  ctm_bitset_clear(c->_discharged, words);
+
+  // The timing wheel is rebuilt from the idle counts, which
+  // it reads off overdue neurons as they are
+  for(CtmId id = 0; id < n; id++) {
+    if(discharged[id/8] & (1 << (id % 8))) {
+      ctm_bitset_set(c->_discharged, id);
+    }
+
+    if(frontier[id/8] & (1 << (id % 8))) {
+      ctm_bitset_set(c->_frontier, id);
+    }
+
+    ctm_bitset_set(c->_overdue, id);
+    c->_idle_slot[id] = idle[id];
+  }
+
+  c->_overdue_any = 0;
+
+  ctm_wheel_build(c, h.max_idle);
+#else
+  // Counts past max_idle are reset next tick either way
+  for(CtmId id = 0; id < n; id++) {
+    const uint8_t count = idle[id] > h.max_idle ? h.max_idle + 1 : idle[id];
+    const uint8_t fired = (discharged[id/8] >> (id % 8)) & 1;
+
+    c->_meta[id] = (fired << 7) | count;
+  }
+
+  (void)frontier;
+#endif
+
+  return 1;
+}
+#endif
+
+#ifdef CTM_FRONTIER
+// Select simulation mode (bitwise OR of CTM_MODE_* flags)
+void ctm_set_mode(Connectome* const c, const uint8_t mode) {
+  // Inputs pinged in since the last tick are added in
+  // before saturation stops being deferred
+  if((c->_mode & CTM_MODE_DEFERRED_SATURATION) && !(mode & CTM_MODE_DEFERRED_SATURATION)) {
+    ctm_saturate(c);
+  }
+
+  c->_mode = mode;
+}
+
+#ifdef CTM_PARALLEL
+// Split the propagation of discharges across the given
+// number of threads; returns 0 and leaves a single thread
+// if they can't be started
+uint8_t ctm_set_threads(Connectome* const c, const uint16_t threads) {
+  ctm_parallel_free(c->_parallel, 1);
+  c->_parallel = NULL;
+
+  if(threads <= 1) {
+    return 1;
+  }
+
+  CtmParallel* const p = calloc(1, sizeof(CtmParallel));
+
+  if(p == NULL) {
+    return 0;
+  }
+
+  p->neuron_start = malloc(((size_t)threads + 1)*sizeof(CtmId));
+  p->muscle_start = malloc(((size_t)threads + 1)*sizeof(CtmId));
+
+#ifdef CTM_STATS
+  p->stats = calloc(threads, sizeof(CtmStats));
+
+  if(p->stats == NULL) {
+    ctm_parallel_free(p, 0);
+    return 0;
+  }
+#endif
+
+  if(p->neuron_start == NULL || p->muscle_start == NULL) {
+    ctm_parallel_free(p, 0);
+    return 0;
+  }
+
+  // Neuron shares start on a word of the touched bitset,
+  // and muscle shares on a cache line
+  const CtmReverseTable* const r = c->_reverse;
+
+  ctm_parallel_split(r, 0, c->_neurons_tot, CTM_BITS_PER_WORD, threads, p->neuron_start);
+  ctm_parallel_split(r, c->_neurons_tot, r->cols, CTM_ALIGN/sizeof(int16_t), threads, p->muscle_start);
+
+  if(!ctm_pool_init(&p->pool, threads)) {
+    ctm_parallel_free(p, 0);
+    return 0;
+  }
+
+  c->_parallel = p;
+
+  return 1;
+}
+#endif
+#endif
+
+// Propagate each neuron connection weight into the next state
+CTM_INLINE void ctm_ping_neuron_in(Connectome* const c, const CtmId id, const int8_t lo, const int8_t hi) {
+#ifdef CTM_SYNAPSE_TABLE
+  const CtmSynapseTable* const t = c->_synapses;
+
+  // Cells without outgoing connections (i.e. muscles)
+  // have no row
+  if(id >= t->rows) {
+    return;
+  }
+
+  const uint32_t end = t->row_offset[id + 1];
+
+  CTM_COUNT(synaptic_events, end - t->row_offset[id]);
+
+  for(uint32_t i = t->row_offset[id]; i < end; i++) {
+    ctm_add_to_next_state(c, t->target[i], t->weight[i], lo, hi);
+  }
+#else
+  const uint16_t* rom = c->_network->rom;
+  const uint16_t address = READ_WORD(rom, id + 1);
+  const uint16_t len = READ_WORD(rom, id + 2) - READ_WORD(rom, id + 1);
+
+  CTM_COUNT(synaptic_events, len);
+
+  for(uint16_t i = 0; i < len; i++) {
+    NeuronConnection neuron_conn = parse_rom_word(READ_WORD(rom, address + i));
+
+    ctm_add_to_next_state(c, neuron_conn.id, neuron_conn.weight, lo, hi);
+  }
+#endif
+}
+
+#ifdef CTM_FRONTIER
+// Add each neuron connection weight into the sums of the
+// tick's inputs (deferred saturation); muscles, which don't
+// saturate, are added to directly
+static void ctm_accumulate_neuron(Connectome* const c, const CtmId id) {
+  const CtmSynapseTable* const t = c->_synapses;
+
+  if(id >= t->rows) {
+    return;
+  }
+
+  const uint32_t end = t->row_offset[id + 1];
+
+  CTM_COUNT(synaptic_events, end - t->row_offset[id]);
+
+  for(uint32_t i = t->row_offset[id]; i < end; i++) {
+    const CtmId target = t->target[i];
+
+    if(target < c->_neurons_tot) {
+      c->_neuron_acc[target] += t->weight[i];
+      ctm_bitset_set(c->_touched, target);
+    }
+    else {
+      c->_muscle_next[target - c->_neurons_tot] += t->weight[i];
+    }
+  }
+}
+#endif
+
+void ctm_ping_neuron(Connectome* const c, const CtmId id) {
+#ifdef CTM_FRONTIER
+  if(c->_mode & CTM_MODE_DEFERRED_SATURATION) {
+    ctm_accumulate_neuron(c, id);
+    return;
+  }
+#endif
+
+  if(c->_clamp_default) {
+    ctm_ping_neuron_in(c, id, -128, 127);
+  }
+  else {
+    ctm_ping_neuron_in(c, id, c->_params.neuron_min, c->_params.neuron_max);
+  }
+}
+
+// Propagate connections and set state to zero (i.e. simulate a neuron
+// discharge)
+void ctm_discharge_neuron(Connectome* const c, const CtmId id) {
+  ctm_ping_neuron(c, id);
+  ctm_set_next_state(c, id, 0);
+
+#ifdef CTM_FRONTIER
+  // Inputs summed so far are lost as well
+  c->_neuron_acc[id] = 0;
+#endif
+}
+
+// One tick, stimulating the neurons in a list and/or a
+// registered stimulus (zero for none)
+CTM_INLINE void ctm_cycle(Connectome* const c, const CtmId* stim_neuron, const CtmId len, const uint16_t stimulus) {
+  CTM_PHASE_START();
+
+  // Iterate through list of neurons to
+  // stimulate this tick, if any
+  if(stim_neuron != NULL) {
+    for(CtmId i = 0; i < len; i++) {
+      CtmId id = stim_neuron[i];
+      ctm_ping_neuron(c, id);
+    }
+
+    CTM_COUNT(stimuli, len);
+  }
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+  if(stimulus != 0 && stimulus <= c->_stimuli_len) {
+    ctm_stimulus_apply(c, &c->_stimuli[stimulus - 1]);
+  }
+#else
+  (void)stimulus;
+#endif
+
+  CTM_PHASE_END(ping);
+
+  // Discharge any neurons over threshold
+#ifdef CTM_FRONTIER
+  ctm_flag_discharges(c);
+
+#ifdef CTM_STATS
+  for(CtmId w = 0; w < CTM_BITSET_WORDS(c->_neurons_tot); w++) {
+    c->_stats_tick.discharges += __builtin_popcountll(c->_discharged[w]);
+  }
+#endif
+
+  ctm_propagate_discharges(c);
+
+  if(c->_mode & CTM_MODE_DEFERRED_SATURATION) {
+    ctm_saturate(c);
+  }
+#else
+  ctm_discharge_scan(c);
+#endif
+
+  CTM_PHASE_END(discharge);
+
+  ctm_meta_handle_idle_neurons(c);
+
+  CTM_PHASE_END(idle);
+
+  ctm_iterate_state(c);
+
+  CTM_PHASE_END(iterate);
+
+#ifdef CTM_PROFILE
+  if(c->_profile != NULL) {
+    c->_profile->ticks++;
+  }
+#endif
+
+#ifdef CTM_STATS
+  ctm_stats_end_tick(c);
+#endif
+}
+
+// Complete one cycle ('tick') of the nematode neural system;
+// accepts an array of neurons to stimulate and the length of
+// that list---otherwise NULL, 0
+void ctm_neural_cycle(Connectome* const c, const CtmId* stim_neuron, const CtmId len) {
+  ctm_cycle(c, stim_neuron, len, 0);
+}
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+// Complete one tick, stimulating with a registered stimulus
+// (zero for none)
+void ctm_stimulus_cycle(Connectome* const c, const CtmStimulus stimulus) {
+  ctm_cycle(c, NULL, 0, stimulus);
+}
+#endif
+
+// Start a cursor at the beginning of a schedule
+void ctm_schedule_start(CtmScheduleCursor* const s, const CtmSchedulePhase* schedule, const uint32_t phases) {
+  // A schedule without ticks stimulates nothing
+  uint64_t ticks = 0;
+
+  for(uint32_t p = 0; schedule != NULL && p < phases; p++) {
+    ticks += schedule[p].ticks;
+  }
+
+  s->_schedule = ticks > 0 ? schedule : NULL;
+  s->_phases = phases;
+  s->_phase = 0;
+  s->_left = s->_schedule != NULL ? schedule[0].ticks : 0;
+}
+
+// Phase of the next ticks of a schedule, moving the cursor
+// past as many of them (up to the given number) as the
+// phase lasts
+const CtmSchedulePhase* ctm_schedule_advance(CtmScheduleCursor* const s, uint64_t* const ticks) {
+  if(s->_schedule == NULL) {
+    return NULL;
+  }
+
+  while(s->_left == 0) {
+    s->_phase = (s->_phase + 1) % s->_phases;
+    s->_left = s->_schedule[s->_phase].ticks;
+  }
+
+  *ticks = s->_left < *ticks ? s->_left : *ticks;
+  s->_left -= *ticks;
+
+  return &s->_schedule[s->_phase];
+}
+
+// Take an observer's sample after the given number of
+// ticks; returns 0 if its callback ends the run
+static uint8_t ctm_observe(Connectome* const c, CtmObserver* const o, const uint64_t ticks) {
+  if(o->samples < o->capacity) {
+    const size_t at = (size_t)o->samples*o->len;
+
+    if(o->discharges != NULL) {
+      ctm_discharge_query(c, o->cells, o->discharges + at, o->len);
+    }
+
+    if(o->states != NULL) {
+      for(CtmId i = 0; i < o->len; i++) {
+        o->states[at + i] = ctm_get_current_state(c, o->cells[i]);
+      }
+    }
+  }
+
+  o->samples++;
+  o->_next += o->stride > 0 ? o->stride : 1;
+
+  return o->fn == NULL || o->fn(c, ticks, o->arg);
+}
+
+// Run the given number of ticks, stimulating neurons as the
+// schedule says and sampling each observer as it asks;
+// returns the number of ticks run
+uint64_t ctm_run(Connectome* const c, const CtmSchedulePhase* schedule, const uint32_t phases, const uint64_t ticks, CtmObserver* observers, const uint32_t len) {
+  CtmScheduleCursor cursor;
+  ctm_schedule_start(&cursor, schedule, phases);
+
+  // Ticks run at the next sample of any observer
+  uint64_t next = UINT64_MAX;
+
+  for(uint32_t i = 0; i < len; i++) {
+    CtmObserver* const o = &observers[i];
+
+    o->samples = 0;
+    o->_next = o->stride > 0 ? o->stride : 1;
+
+    next = o->_next < next ? o->_next : next;
+  }
+
+  uint64_t t = 0;
+
+  while(t < ticks) {
+    // Stretch of ticks with the same stimulus and no
+    // sample before its end
+    uint64_t stretch = next - t < ticks - t ? next - t : ticks - t;
+
+    const CtmSchedulePhase* const phase = ctm_schedule_advance(&cursor, &stretch);
+    const CtmId* ids = phase != NULL ? phase->stimulus : NULL;
+    const CtmId n = ids != NULL ? phase->len : 0;
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+    if(phase != NULL && phase->cached != 0) {
+      for(uint64_t i = 0; i < stretch; i++) {
+        ctm_stimulus_cycle(c, phase->cached);
+      }
+    }
+    else
+#endif
+    for(uint64_t i = 0; i < stretch; i++) {
+      ctm_neural_cycle(c, ids, n);
+    }
+
+    t += stretch;
+
+    if(t == next) {
+      uint8_t go = 1;
+
+      next = UINT64_MAX;
+
+      for(uint32_t i = 0; i < len; i++) {
+        CtmObserver* const o = &observers[i];
+
+        if(o->_next == t) {
+          go &= ctm_observe(c, o, t);
+        }
+
+        next = o->_next < next ? o->_next : next;
+      }
+
+      if(!go) {
+        break;
+      }
+    }
+  }
+
+  return t;
+}
+
+// Utility functions
+
+// Current state of every neuron and muscle (valid until the
+// next tick)
+const int8_t* ctm_neuron_state(const Connectome* const c) {
+  return c->_neuron_current;
+}
+
+const int16_t* ctm_muscle_state(const Connectome* const c) {
+  return c->_muscle_current;
+}
 
 // Functions for returning cell weights
-int16_t ctm_get_weight(Connectome* const c, const uint16_t id) {
+int16_t ctm_get_weight(Connectome* const c, const CtmId id) {
   int16_t weight = ctm_get_current_state(c, id);
 
   return weight;
 }
 
-void ctm_weight_query(Connectome* const c, const uint16_t* input_id, uint16_t* query_result, const uint16_t len_query) {
-  for(uint16_t i = 0; i < len_query; i++) {
-    uint16_t id = input_id[i];
+void ctm_weight_query(Connectome* const c, const CtmId* input_id, uint16_t* query_result, const CtmId len_query) {
+  for(CtmId i = 0; i < len_query; i++) {
+    CtmId id = input_id[i];
     int16_t weight = ctm_get_current_state(c, id);
     query_result[i] = weight;
   }
@@ -226,16 +1909,24 @@ void ctm_weight_query(Connectome* const c, const uint16_t* input_id, uint16_t* q
 
 // Check whether or not one or more neurons discharged 
 // in the last tick
-uint8_t ctm_get_discharge(Connectome* const c, const uint16_t id) {
+uint8_t ctm_get_discharge(Connectome* const c, const CtmId id) {
+#ifdef CTM_FRONTIER
+  uint8_t discharged = ctm_bitset_get(c->_discharged, id);
+#else
   uint8_t discharged = c->_meta[id] >> 7;
+#endif
 
   return discharged;
 }
 
-void ctm_discharge_query(Connectome* const c, const uint16_t* input_id, uint8_t* query_result, const uint16_t len_query) {
-  for(uint16_t i = 0; i < len_query; i++) {
-    uint16_t id = input_id[i];
+void ctm_discharge_query(Connectome* const c, const CtmId* input_id, uint8_t* query_result, const CtmId len_query) {
+  for(CtmId i = 0; i < len_query; i++) {
+    CtmId id = input_id[i];
+#ifdef CTM_FRONTIER
+    uint8_t discharged = ctm_bitset_get(c->_discharged, id);
+#else
     uint8_t discharged = c->_meta[id] >> 7;
+#endif
     query_result[i] = discharged;
   }
 }
@@ -7,25 +7,204 @@
 
 #include "defines.h"
 #include "neural_rom.h"
+#include "synapse_table.h"
+#include "network.h"
+#include "bitset.h"
+#include "kernels.h"
+
+//
+// Simulation modes (see ctm_set_mode)
+//
+
+// Only neurons that received input during the previous
+// tick are checked against THRESHOLD
+#define CTM_MODE_EVENT_DRIVEN 0x01
+
+// Discharges are propagated by having every cell gather
+// from its discharging inputs (through a reverse index),
+// rather than by each discharging neuron scattering into
+// its targets; results are identical
+#define CTM_MODE_PULL 0x02
+
+// Synaptic inputs are summed at full width and each neuron
+// is clamped once, when the tick's inputs are all in,
+// rather than after every input; results then no longer
+// depend on the order inputs are added in, and differ from
+// the default mode's only where a neuron would have
+// saturated part way through a tick (see
+// tools/ctm_saturation_report.c)
+#define CTM_MODE_DEFERRED_SATURATION 0x04
+
+// Registered stimuli (see ctm_register_stimulus) are added
+// to each neuron they reach with one saturating add, rather
+// than reproducing the clamp after every connection that
+// pinging does; results differ only where a neuron would
+// have saturated part way through the stimulus (deferred
+// saturation sums the stimulus either way)
+#define CTM_MODE_FAST_STIMULUS 0x08
+
+//
+// Simulation parameters (see ctm_set_params)
+//
+
+typedef struct {
+  // Value at which neurons fire
+  int8_t threshold;
+
+  // Maximum number of cycles a neuron can be idle
+  // before state reset to zero
+  uint8_t max_idle;
+
+  // Range neuron states are clamped to (must
+  // contain zero)
+  int8_t neuron_min;
+  int8_t neuron_max;
+} CtmParams;
+
+#ifdef CTM_PROFILE
+//
+// Time spent in each phase of ctm_neural_cycle, in
+// nanoseconds summed over ticks (builds with CTM_PROFILE
+// defined only; see ctm_set_profile)
+//
+
+typedef struct {
+  uint64_t ticks;
+
+  // Stimulus pings
+  uint64_t ping;
+
+  // Finding and propagating discharges
+  uint64_t discharge;
+
+  // Idle handling
+  uint64_t idle;
+
+  // State iteration
+  uint64_t iterate;
+} CtmProfile;
+#endif
+
+#ifdef CTM_STATS
+//
+// Counts of what the simulation did, for a tick or summed
+// over ticks (builds with CTM_STATS defined only; see
+// ctm_stats)
+//
+
+typedef struct {
+  uint64_t ticks;
+
+  // Neurons pinged by the stimulus
+  uint64_t stimuli;
+
+  // Neurons that discharged
+  uint64_t discharges;
+
+  // Connection weights added into a next state
+  uint64_t synaptic_events;
+
+  // Neuron states clamped to neuron_min or neuron_max
+  uint64_t saturations;
+
+  // Neurons reset to zero after idling at a nonzero state
+  uint64_t idle_resets;
+} CtmStats;
+#endif
+
+#ifdef CTM_SNAPSHOT
+//
+// State snapshots (see ctm_save_state)
+//
+// Snapshots are taken between ticks, and hold everything
+// the ticks after them depend on. Fields are in host byte
+// order:
+//
+// Header (CtmStateHeader)
+// Neuron states (int8, one per neuron)
+// Muscle states (int16, one per muscle)
+// Idle counts (uint8, one per neuron: ticks each neuron's
+// state has gone unchanged, as of the last tick)
+// Discharge bits of the last tick (one per neuron, packed
+// low bit first into bytes)
+// Bits of the neurons that received input during the last
+// tick, packed the same way
+//
+
+#define CTM_STATE_MAGIC "CTMS"
+#define CTM_STATE_VERSION 1
+
+typedef struct {
+  char magic[4];
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t cells;
+  uint32_t neurons;
+
+  // Network the snapshot was taken of (see
+  // ctm_network_hash)
+  uint64_t network_hash;
+
+  // Simulation parameters
+  int8_t threshold;
+  uint8_t max_idle;
+  int8_t neuron_min;
+  int8_t neuron_max;
+  uint32_t reserved2;
+} CtmStateHeader;
+#endif
+
+// Number of idle timing wheel slots (one more than the
+// largest max_idle)
+#define CTM_WHEEL_SLOTS 256
 
 //
 // Struct that contains cell states
 //
 // Simulation projects current state in next,
-// then copies next into current and repeats
+// then swaps next and current and repeats
+//
+// Every array lives in one block (see ctm_required_size),
+// either allocated by ctm_init or supplied by the caller
 //
 
 typedef struct {
   // Point to _neuron_current
-  // and _muscle_current arrays
+  // and _muscle_current arrays (which trade places with
+  // the next state every tick; see ctm_neuron_state)
   int8_t* neuron_state;
   int16_t* muscle_state;
 
+  // Wiring being simulated
+  const CtmNetwork* _network;
+
   // Total number of neuron type cells
-  uint16_t _neurons_tot;
+  CtmId _neurons_tot;
   
   // Total number of muscle type cells
-  uint8_t _muscles_tot;
+  CtmId _muscles_tot;
+
+  // Simulation parameters, and whether neuron states are
+  // clamped to the full int8 range (the specialized case)
+  CtmParams _params;
+  uint8_t _clamp_default;
+
+  // Block allocated by ctm_init (NULL if the caller
+  // supplied it)
+  void* _block;
+
+#ifdef CTM_PROFILE
+  // Phase timings being gathered, if any
+  CtmProfile* _profile;
+#endif
+
+#ifdef CTM_STATS
+  // Counts for the tick under way, the last tick and every
+  // tick since they were reset
+  CtmStats _stats_tick;
+  CtmStats _stats_last;
+  CtmStats _stats_total;
+#endif
 
   // Current state
   int8_t* _neuron_current;
@@ -35,43 +214,299 @@ typedef struct {
   int8_t* _neuron_next;
   int16_t* _muscle_next;
 
+#ifndef CTM_FRONTIER
   // Meta array holds information about how long a neuron
   // has been idle in the lower 7 bits (i.e. how many
   // ticks since it last discharged) and whether or not it
   // discharged this tick in the high bit
   uint8_t* _meta;
+#endif
+
+#ifdef CTM_SYNAPSE_TABLE
+  // Connections decoded from the network's ROM words
+  const CtmSynapseTable* _synapses;
+#endif
+
+#ifdef CTM_FRONTIER
+  // Simulation mode flags
+  uint8_t _mode;
+
+  // Neurons whose next state was added to this tick, and
+  // those added to last tick (the only neurons that can
+  // be over threshold now)
+  CtmBitWord* _touched;
+  CtmBitWord* _frontier;
+
+  // Inputs summed so far this tick, with deferred
+  // saturation (zero for untouched neurons)
+  CtmSum* _neuron_acc;
+
+  // Incoming connections of every cell
+  const CtmReverseTable* _reverse;
+
+#ifdef CTM_PARALLEL
+  // Threads propagating discharges and their share of the
+  // cells, if there is more than one (see ctm_set_threads)
+  struct CtmParallel* _parallel;
+#endif
+
+#ifdef CTM_STIMULUS_CACHE
+  // Registered stimuli (see ctm_register_stimulus)
+  struct CtmStimulusCache* _stimuli;
+  uint16_t _stimuli_len;
+#endif
+
+  // Whole-array kernels picked for this CPU
+  const CtmKernels* _kernels;
+
+  // Whether or not each neuron discharged this tick
+  CtmBitWord* _discharged;
+
+  // Neurons whose next state differs from their current
+  // state (scratch space for idle handling)
+  CtmBitWord* _changed;
+
+  // Wheel slot in which each neuron's idle count returns to
+  // zero (its count keeps cycling through the wheel once it
+  // is at rest), or for overdue neurons, the count itself
+  uint8_t* _idle_slot;
+
+  // Neurons whose idle count is past a newly lowered
+  // max_idle, and are reset next tick unless they discharge
+  CtmBitWord* _overdue;
+  uint8_t _overdue_any;
+
+  // Timing wheel of idle resets: each of the max_idle + 1
+  // slots is a circular doubly-linked list of the neurons
+  // due to be reset to zero when it comes around, unless
+  // their state changes first. Entries below _neurons_tot
+  // are neurons, each in at most one list (unlisted ones
+  // link to themselves), and the CTM_WHEEL_SLOTS entries
+  // above them are the heads of the lists
+  CtmId* _wheel_next;
+  CtmId* _wheel_prev;
+
+  // Slot that is due this tick
+  uint8_t _wheel_slot;
+#endif
 
 } Connectome;
 
+//
+// Batched runs (see ctm_run)
+//
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+// Handle of a stimulus registered with a simulation (see
+// ctm_register_stimulus), or zero for none
+typedef uint16_t CtmStimulus;
+#endif
+
+// One stretch of a stimulus schedule
+typedef struct {
+  // Neurons pinged every tick (NULL for none)
+  const CtmId* stimulus;
+  CtmId len;
+
+  // Ticks the stretch lasts
+  uint32_t ticks;
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+  // Registered stimulus applied instead of the list, if
+  // not zero
+  CtmStimulus cached;
+#endif
+} CtmSchedulePhase;
+
+// Position in a stimulus schedule, for stepping through it
+// as ctm_run does (see ctm_schedule_start)
+typedef struct {
+  // Schedule (NULL if it stimulates nothing), its number
+  // of phases, the current one, and its ticks left
+  const CtmSchedulePhase* _schedule;
+  uint32_t _phases;
+  uint32_t _phase;
+  uint64_t _left;
+} CtmScheduleCursor;
+
+// Callback of an observer, given the number of ticks run
+// so far; returns 0 to end the run after this tick
+typedef uint8_t (*CtmObserverFn)(Connectome* const, const uint64_t, void*);
+
+// Sampled every stride ticks (zero is taken as one), after
+// the stride-th, the 2*stride-th and so on
+typedef struct {
+  uint32_t stride;
+
+  // Called at each sample (NULL for none)
+  CtmObserverFn fn;
+  void* arg;
+
+  // Cells written out at each sample, into buffers with
+  // room for len entries per sample and capacity samples;
+  // whether each neuron discharged goes to discharges, and
+  // each cell's state to states (either may be NULL)
+  const CtmId* cells;
+  CtmId len;
+  uint8_t* discharges;
+  int16_t* states;
+  uint32_t capacity;
+
+  // Samples taken (set by ctm_run; buffers stop filling
+  // once it reaches capacity)
+  uint32_t samples;
+
+  // Ticks run at the next sample
+  uint64_t _next;
+} CtmObserver;
+
 //
 // Functions that provide primary interface to
 // connectome emulation
 //
 
-// Function for initializing connectome struct
-void ctm_init(Connectome* const);
+// Function for initializing connectome struct to simulate
+// the given network (which must outlive it); returns 0 if
+// its state can't be allocated
+uint8_t ctm_init(Connectome* const, const CtmNetwork* const);
+
+// Size in bytes of the block holding a simulation's state
+size_t ctm_required_size(const CtmNetwork* const);
+
+// Initializes a connectome struct with its state in the
+// given block (aligned to CTM_ALIGN, and at least
+// ctm_required_size bytes), which must outlive it; returns
+// 0 if the block is misaligned or too small
+uint8_t ctm_init_in_buffer(Connectome* const, const CtmNetwork* const, void*, const size_t);
+
+// Releases the state allocated by ctm_init (a block the
+// caller supplied is left alone, and can be reused), stops
+// any threads of its own and drops registered stimuli
+void ctm_free(Connectome* const);
+
+// Fills in the compiled-in parameters (THRESHOLD, MAX_IDLE
+// and the full int8 range)
+void ctm_default_params(CtmParams* const);
+
+// Sets simulation parameters; returns 0 and leaves the
+// parameters as they were if they are invalid
+uint8_t ctm_set_params(Connectome* const, const CtmParams* const);
+
+#ifdef CTM_FRONTIER
+// Selects simulation mode (bitwise OR of CTM_MODE_* flags)
+void ctm_set_mode(Connectome* const, const uint8_t);
+#endif
+
+#if defined(CTM_FRONTIER) && defined(CTM_PARALLEL)
+// Splits the propagation of discharges across the given
+// number of threads (the calling thread is one of them;
+// one or zero goes back to a single thread), each pulling
+// the inputs of its own share of the cells as in
+// CTM_MODE_PULL (whatever the mode); results are identical
+// whatever the number of threads. Returns 0 and leaves a
+// single thread if they can't be started
+//
+// A connectome with threads of its own needs ctm_free
+// (even in a block the caller supplied) to stop them
+uint8_t ctm_set_threads(Connectome* const, const uint16_t);
+#endif
+
+#ifdef CTM_PROFILE
+// Starts adding each tick's phase timings to the given
+// profile (NULL stops)
+void ctm_set_profile(Connectome* const, CtmProfile* const);
+#endif
+
+#ifdef CTM_STATS
+// Copies out the counts summed over every tick since
+// ctm_init or ctm_stats_reset, and those of the last tick
+// alone (either may be NULL)
+void ctm_stats(const Connectome* const, CtmStats* const, CtmStats* const);
+
+// Zeroes the counts
+void ctm_stats_reset(Connectome* const);
+#endif
+
+#ifdef CTM_SNAPSHOT
+// Size in bytes of a snapshot of a simulation's state
+size_t ctm_state_size(const Connectome* const);
+
+// Writes a snapshot of the state between ticks (including
+// its parameters) into the given buffer; returns 0 if the
+// buffer is too small
+uint8_t ctm_save_state(const Connectome* const, void*, const size_t);
+
+// Restores a snapshot, after which the simulation carries
+// on exactly as the one it was taken of would have; returns
+// 0 and leaves the state as it was if the buffer isn't a
+// snapshot of a simulation of the same network
+uint8_t ctm_load_state(Connectome* const, const void*, const size_t);
+#endif
 
 // Propagates each neuron connection weight into the next state
-void ctm_ping_neuron(Connectome* const, const uint16_t);
+void ctm_ping_neuron(Connectome* const, const CtmId);
 
 // Propagates connections and sets state to zero, simulating
 // a neuron discharge
-void ctm_discharge_neuron(Connectome* const, const uint16_t);
+void ctm_discharge_neuron(Connectome* const, const CtmId);
 
 // Completes one cycle ('tick') of the nematode neural system
 // accepts an array of neurons to stimulate and the length of
 // that list---otherwise NULL, 0
-void ctm_neural_cycle(Connectome* const, const uint16_t*, const uint16_t);
+void ctm_neural_cycle(Connectome* const, const CtmId*, const CtmId);
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+// Registers a list of neurons to stimulate, compiling it
+// into the summed weights it adds to each cell it reaches;
+// returns its handle, or zero if an id is out of range or
+// memory runs out. Handles belong to the simulation they
+// were registered with
+//
+// A connectome with registered stimuli needs ctm_free
+// (even in a block the caller supplied) to release them
+CtmStimulus ctm_register_stimulus(Connectome* const, const CtmId*, const CtmId);
+
+// Completes one tick, stimulating with a registered
+// stimulus (zero for none); the tick is the same as
+// ctm_neural_cycle's with the registered list, unless
+// CTM_MODE_FAST_STIMULUS is set
+void ctm_stimulus_cycle(Connectome* const, const CtmStimulus);
+#endif
+
+// Runs the given number of ticks, stimulating neurons as
+// the schedule says (starting over once it runs out; NULL
+// or a schedule without ticks for no stimulus), and
+// sampling each observer as it asks; returns the number of
+// ticks run, which is fewer only if an observer ends the
+// run. Ticks are the same as those of ctm_neural_cycle
+uint64_t ctm_run(Connectome* const, const CtmSchedulePhase*, const uint32_t, const uint64_t, CtmObserver*, const uint32_t);
+
+// Starts a cursor at the beginning of a schedule, which
+// starts over once it runs out (NULL or a schedule without
+// ticks for no stimulus)
+void ctm_schedule_start(CtmScheduleCursor* const, const CtmSchedulePhase*, const uint32_t);
+
+// Returns the phase the next ticks of a schedule are in
+// (NULL for no stimulus), and moves the cursor past them:
+// as many as the phase lasts, up to the given number,
+// which is set to how many that is (and left alone if
+// there is no stimulus)
+const CtmSchedulePhase* ctm_schedule_advance(CtmScheduleCursor* const, uint64_t* const);
 
 // Utility functions
 
+// Current state of every neuron and muscle (valid until the
+// next tick)
+const int8_t* ctm_neuron_state(const Connectome* const);
+const int16_t* ctm_muscle_state(const Connectome* const);
+
 // Functions for returning cell weights
-int16_t ctm_get_weight(Connectome* const, const uint16_t);
-void ctm_weight_query(Connectome* const, const uint16_t*, uint16_t*, const uint16_t);
+int16_t ctm_get_weight(Connectome* const, const CtmId);
+void ctm_weight_query(Connectome* const, const CtmId*, uint16_t*, const CtmId);
 
 // Check whether or not one or more neurons discharged 
 // in the last tick
-uint8_t ctm_get_discharge(Connectome* const, const uint16_t);
-void ctm_discharge_query(Connectome* const, const uint16_t*, uint8_t*, const uint16_t);
+uint8_t ctm_get_discharge(Connectome* const, const CtmId);
+void ctm_discharge_query(Connectome* const, const CtmId*, uint8_t*, const CtmId);
 
 #endif
@@ -15,6 +15,54 @@
 #else
 #define LARGE_CONST_ARR
 #define READ_WORD(ARR, IDX) ARR[IDX]
+
+// Hosts with RAM to spare expand the ROM into a
+// pre-decoded synapse table at init instead of
+// parsing ROM words on every ping
+#define CTM_SYNAPSE_TABLE
+
+// Track which neurons receive input each tick, so that
+// discharges and idle resets can be driven by that
+// activity rather than by scanning every neuron
+#define CTM_FRONTIER
+
+// Connectomes can be loaded from (memory-mapped) binary
+// files as well as from the compiled-in NEURAL_ROM
+#define CTM_NETWORK_FILE
+
+// Cell ids and connection weights are wide enough for the
+// wide connectome encoding (see wide_rom.h)
+#define CTM_WIDE_NETWORKS
+
+// Discharges can be traced to binary files by a background
+// writer thread (see trace.h; link with -lpthread)
+#define CTM_TRACE
+
+// Simulation state can be saved to and restored from
+// snapshots (see ctm_save_state)
+#define CTM_SNAPSHOT
+
+// Batches of experiments can be run by a pool of worker
+// threads (see runner.h; link with -lpthread)
+#define CTM_RUNNER
+
+// Discharges of a single simulation can be propagated by
+// several threads at once (see ctm_set_threads; link with
+// -lpthread)
+#define CTM_PARALLEL
+
+// Stimuli can be registered once and applied every tick
+// from precompiled per-target sums, rather than pinged
+// neuron by neuron (see ctm_register_stimulus)
+#define CTM_STIMULUS_CACHE
+#endif
+
+// Alignment of each array in a simulation's state block
+// (cache lines, except where RAM is too scarce to pad)
+#ifdef ARDUINO_AVR_UNO
+#define CTM_ALIGN 2
+#else
+#define CTM_ALIGN 64
 #endif
 
 //
@@ -0,0 +1,347 @@
+#include "ensemble.h"
+
+#ifdef CTM_SYNAPSE_TABLE
+
+//
+// Vector helpers
+//
+// Each helper works on ENS_WIDTH instances of one cell;
+// int8 lanes hold either neuron states or 0/-1 masks
+//
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+#define ENS_WIDTH 32
+
+typedef __m256i EnsVec;
+
+#define ens_load(P) _mm256_loadu_si256((const __m256i*)(P))
+#define ens_store(P, V) _mm256_storeu_si256((__m256i*)(P), (V))
+#define ens_set1(X) _mm256_set1_epi8((char)(X))
+#define ens_gt(A, B) _mm256_cmpgt_epi8((A), (B))
+#define ens_eq(A, B) _mm256_cmpeq_epi8((A), (B))
+#define ens_add(A, B) _mm256_add_epi8((A), (B))
+#define ens_adds(A, B) _mm256_adds_epi8((A), (B))
+#define ens_and(A, B) _mm256_and_si256((A), (B))
+#define ens_andnot(M, A) _mm256_andnot_si256((M), (A))
+#define ens_none(M) _mm256_testz_si256((M), (M))
+
+// Add a masked weight to ENS_WIDTH muscle states
+static inline void ens_add_muscle(int16_t* next, const EnsVec m, const CtmWeight weight) {
+  const __m256i w = _mm256_set1_epi16(weight);
+  const __m256i m_lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(m));
+  const __m256i m_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(m, 1));
+
+  __m256i lo = _mm256_loadu_si256((const __m256i*)next);
+  __m256i hi = _mm256_loadu_si256((const __m256i*)(next + 16));
+  lo = _mm256_add_epi16(lo, _mm256_and_si256(m_lo, w));
+  hi = _mm256_add_epi16(hi, _mm256_and_si256(m_hi, w));
+  _mm256_storeu_si256((__m256i*)next, lo);
+  _mm256_storeu_si256((__m256i*)(next + 16), hi);
+}
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+#define ENS_WIDTH 16
+
+typedef __m128i EnsVec;
+
+#define ens_load(P) _mm_loadu_si128((const __m128i*)(P))
+#define ens_store(P, V) _mm_storeu_si128((__m128i*)(P), (V))
+#define ens_set1(X) _mm_set1_epi8((char)(X))
+#define ens_gt(A, B) _mm_cmpgt_epi8((A), (B))
+#define ens_eq(A, B) _mm_cmpeq_epi8((A), (B))
+#define ens_add(A, B) _mm_add_epi8((A), (B))
+#define ens_adds(A, B) _mm_adds_epi8((A), (B))
+#define ens_and(A, B) _mm_and_si128((A), (B))
+#define ens_andnot(M, A) _mm_andnot_si128((M), (A))
+#define ens_none(M) (_mm_movemask_epi8(M) == 0)
+
+// Add a masked weight to ENS_WIDTH muscle states
+static inline void ens_add_muscle(int16_t* next, const EnsVec m, const CtmWeight weight) {
+  const __m128i w = _mm_set1_epi16(weight);
+
+  __m128i lo = _mm_loadu_si128((const __m128i*)next);
+  __m128i hi = _mm_loadu_si128((const __m128i*)(next + 8));
+  lo = _mm_add_epi16(lo, _mm_and_si128(_mm_unpacklo_epi8(m, m), w));
+  hi = _mm_add_epi16(hi, _mm_and_si128(_mm_unpackhi_epi8(m, m), w));
+  _mm_storeu_si128((__m128i*)next, lo);
+  _mm_storeu_si128((__m128i*)(next + 8), hi);
+}
+
+#else
+
+#define ENS_WIDTH 1
+
+typedef int8_t EnsVec;
+
+static inline int8_t ens_clamp(const int16_t val) {
+  if(val > 127) {
+    return 127;
+  }
+  else if(val < -128) {
+    return -128;
+  }
+  return (int8_t)val;
+}
+
+#define ens_load(P) (*(const int8_t*)(P))
+#define ens_store(P, V) (*(int8_t*)(P) = (V))
+#define ens_set1(X) ((int8_t)(X))
+#define ens_gt(A, B) ((int8_t)-((A) > (B)))
+#define ens_eq(A, B) ((int8_t)-((A) == (B)))
+#define ens_add(A, B) ((int8_t)((A) + (B)))
+#define ens_adds(A, B) ens_clamp((int16_t)(A) + (B))
+#define ens_and(A, B) ((int8_t)((A) & (B)))
+#define ens_andnot(M, A) ((int8_t)(~(M) & (A)))
+#define ens_none(M) ((M) == 0)
+
+// Add a masked weight to ENS_WIDTH muscle states
+static inline void ens_add_muscle(int16_t* next, const EnsVec m, const CtmWeight weight) {
+  if(m) {
+    *next = (int16_t)(*next + weight);
+  }
+}
+
+#endif
+
+// Largest part of a weight that fits in an int8 lane
+static inline int8_t ens_weight_part(const CtmSum weight) {
+  return weight > 127 ? 127 : (weight < -128 ? -128 : (int8_t)weight);
+}
+
+//
+// Per-instance helpers
+//
+
+// Saturating add into a single instance's next state,
+// as done by ctm_add_to_next_state
+static void ens_add_to_next_state(CtmEnsemble* const e, const CtmId id, const uint16_t k, const CtmWeight val) {
+  if(id < e->_neurons_tot) {
+    int8_t* next = &e->_neuron_next[(size_t)id*e->_stride + k];
+    CtmSum sum = *next + val;
+
+    if(sum > 127) {
+      *next = 127;
+    }
+    else if(sum < -128) {
+      *next = -128;
+    }
+    else {
+      *next = (int8_t)sum;
+    }
+  }
+  else {
+    int16_t* next = &e->_muscle_next[(size_t)(id - e->_neurons_tot)*e->_stride + k];
+    *next = (int16_t)(*next + val);
+  }
+}
+
+// Propagate one neuron's connections in a single instance
+static void ens_ping_neuron(CtmEnsemble* const e, const CtmId id, const uint16_t k) {
+  const CtmSynapseTable* const t = e->_synapses;
+
+  if(id >= t->rows) {
+    return;
+  }
+
+  const uint32_t end = t->row_offset[id + 1];
+
+  for(uint32_t i = t->row_offset[id]; i < end; i++) {
+    ens_add_to_next_state(e, t->target[i], k, t->weight[i]);
+  }
+}
+
+//
+// Tick phases
+//
+
+// Discharge every neuron over threshold in every instance;
+// lanes that don't fire add zero, which leaves them untouched
+static void ens_discharge_neurons(CtmEnsemble* const e) {
+  const CtmSynapseTable* const t = e->_synapses;
+  const uint32_t stride = e->_stride;
+  const EnsVec threshold = ens_set1(THRESHOLD);
+  const EnsVec one = ens_set1(1);
+
+  for(CtmId i = 0; i < e->_neurons_tot; i++) {
+    const size_t row = (size_t)i*stride;
+
+    for(uint32_t k = 0; k < stride; k += ENS_WIDTH) {
+      const EnsVec fire = ens_gt(ens_load(&e->_neuron_current[row + k]), threshold);
+
+      ens_store(&e->_discharge[row + k], ens_and(fire, one));
+
+      if(ens_none(fire)) {
+        continue;
+      }
+
+      if(i < t->rows) {
+        const uint32_t end = t->row_offset[i + 1];
+
+        for(uint32_t j = t->row_offset[i]; j < end; j++) {
+          const CtmId target = t->target[j];
+          const CtmWeight weight = t->weight[j];
+
+          if(target < e->_neurons_tot) {
+            int8_t* next = &e->_neuron_next[(size_t)target*stride + k];
+
+            // Weights past the int8 range are added in parts,
+            // all in the same direction, which gives the same
+            // result as one wide saturating add (and anything
+            // past 255 saturates every state anyway)
+            CtmSum rest = weight > 255 ? 255 : (weight < -256 ? -256 : weight);
+
+            do {
+              const int8_t part = ens_weight_part(rest);
+
+              ens_store(next, ens_adds(ens_load(next), ens_and(fire, ens_set1(part))));
+              rest -= part;
+            } while(rest != 0);
+          }
+          else {
+            ens_add_muscle(&e->_muscle_next[(size_t)(target - e->_neurons_tot)*stride + k], fire, weight);
+          }
+        }
+      }
+
+      // Discharged neurons go to zero and restart their idle count
+      ens_store(&e->_neuron_next[row + k], ens_andnot(fire, ens_load(&e->_neuron_next[row + k])));
+      ens_store(&e->_idle[row + k], ens_andnot(fire, ens_load(&e->_idle[row + k])));
+    }
+  }
+}
+
+// Flush neurons that have been idle for a while
+static void ens_handle_idle_neurons(CtmEnsemble* const e) {
+  const size_t len = (size_t)e->_neurons_tot*e->_stride;
+  const EnsVec max_idle = ens_set1(MAX_IDLE);
+  const EnsVec one = ens_set1(1);
+
+  for(size_t i = 0; i < len; i += ENS_WIDTH) {
+    const EnsVec next = ens_load(&e->_neuron_next[i]);
+    const EnsVec same = ens_eq(next, ens_load(&e->_neuron_current[i]));
+
+    // Count up while unchanged, otherwise restart
+    const EnsVec idle = ens_and(same, ens_add(ens_load(&e->_idle[i]), one));
+    const EnsVec expired = ens_gt(idle, max_idle);
+
+    ens_store(&e->_neuron_next[i], ens_andnot(expired, next));
+    ens_store(&e->_idle[i], ens_andnot(expired, idle));
+  }
+}
+
+// Copy 'next' state into 'current' state,
+// flush the muscles in 'next' state
+static void ens_iterate_state(CtmEnsemble* const e) {
+  const size_t neuron_len = (size_t)e->_neurons_tot*e->_stride;
+  const size_t muscle_len = (size_t)e->_muscles_tot*e->_stride;
+
+  memcpy(e->_neuron_current, e->_neuron_next, neuron_len*sizeof(e->_neuron_next[0]));
+  memcpy(e->_muscle_current, e->_muscle_next, muscle_len*sizeof(e->_muscle_next[0]));
+
+  memset(e->_muscle_next, 0, muscle_len*sizeof(e->_muscle_next[0]));
+}
+
+//
+// Functions that provide primary interface to
+// ensemble emulation
+//
+
+// Function for initializing ensemble struct to simulate the
+// given network (which must outlive it); returns 0 if
+// memory runs out
+uint8_t ctm_ensemble_init(CtmEnsemble* const e, const CtmNetwork* const net, const uint16_t instances) {
+  e->instances = instances;
+  e->_stride = ((uint32_t)instances + CTM_ENSEMBLE_LANES - 1)/CTM_ENSEMBLE_LANES*CTM_ENSEMBLE_LANES;
+
+  e->_neurons_tot = net->neurons;
+  e->_muscles_tot = net->cells - e->_neurons_tot;
+
+  const size_t neuron_len = (size_t)e->_neurons_tot*e->_stride;
+  const size_t muscle_len = (size_t)e->_muscles_tot*e->_stride;
+
+  // Allocate and zero state arrays
+  e->_neuron_current = calloc(neuron_len, sizeof(int8_t));
+  e->_neuron_next = calloc(neuron_len, sizeof(int8_t));
+  e->_muscle_current = calloc(muscle_len, sizeof(int16_t));
+  e->_muscle_next = calloc(muscle_len, sizeof(int16_t));
+  e->_idle = calloc(neuron_len, sizeof(uint8_t));
+  e->_discharge = calloc(neuron_len, sizeof(uint8_t));
+
+  e->_synapses = &net->_synapses;
+
+  if(e->_neuron_current == NULL || e->_neuron_next == NULL ||
+     e->_muscle_current == NULL || e->_muscle_next == NULL ||
+     e->_idle == NULL || e->_discharge == NULL) {
+    ctm_ensemble_free(e);
+    return 0;
+  }
+
+  return 1;
+}
+
+// Release the ensemble's state (which may be released
+// again)
+void ctm_ensemble_free(CtmEnsemble* const e) {
+  free(e->_neuron_current);
+  free(e->_neuron_next);
+  free(e->_muscle_current);
+  free(e->_muscle_next);
+  free(e->_idle);
+  free(e->_discharge);
+
+  e->_neuron_current = NULL;
+  e->_neuron_next = NULL;
+  e->_muscle_current = NULL;
+  e->_muscle_next = NULL;
+  e->_idle = NULL;
+  e->_discharge = NULL;
+}
+
+// Complete one tick of every instance; accepts one
+// stimulus list per instance---otherwise NULL
+void ctm_ensemble_cycle(CtmEnsemble* const e, const CtmStimulusList* stim) {
+  // Stimulus lists differ between instances, so these
+  // are applied one instance at a time
+  if(stim != NULL) {
+    for(uint16_t k = 0; k < e->instances; k++) {
+      if(stim[k].id == NULL) {
+        continue;
+      }
+
+      for(CtmId i = 0; i < stim[k].len; i++) {
+        ens_ping_neuron(e, stim[k].id[i], k);
+      }
+    }
+  }
+
+  ens_discharge_neurons(e);
+  ens_handle_idle_neurons(e);
+  ens_iterate_state(e);
+}
+
+// Utility functions (instance, then cell id)
+
+int16_t ctm_ensemble_get_weight(CtmEnsemble* const e, const uint16_t k, const CtmId id) {
+  if(id < e->_neurons_tot) {
+    return e->_neuron_current[(size_t)id*e->_stride + k];
+  }
+  else {
+    return e->_muscle_current[(size_t)(id - e->_neurons_tot)*e->_stride + k];
+  }
+}
+
+uint8_t ctm_ensemble_get_discharge(CtmEnsemble* const e, const uint16_t k, const CtmId id) {
+  return e->_discharge[(size_t)id*e->_stride + k];
+}
+
+void ctm_ensemble_discharge_query(CtmEnsemble* const e, const uint16_t k, const CtmId* input_id, uint8_t* query_result, const CtmId len_query) {
+  for(CtmId i = 0; i < len_query; i++) {
+    query_result[i] = e->_discharge[(size_t)input_id[i]*e->_stride + k];
+  }
+}
+
+#endif
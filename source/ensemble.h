@@ -0,0 +1,88 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "neural_rom.h"
+#include "synapse_table.h"
+#include "network.h"
+
+#ifdef CTM_SYNAPSE_TABLE
+
+//
+// Struct that simulates many independent worms at once
+//
+// Cell states are stored as [cell][instance], so that one
+// pass over the shared connection table updates the same
+// cell in every instance with wide saturating adds. Each
+// instance evolves exactly as a Connectome would.
+//
+
+// Instance counts are padded to a multiple of this
+#define CTM_ENSEMBLE_LANES 32
+
+typedef struct {
+  // Number of simulated instances
+  uint16_t instances;
+
+  // Row length of each state array (instances
+  // padded to CTM_ENSEMBLE_LANES, which can be past the
+  // range of a uint16_t)
+  uint32_t _stride;
+
+  // Total number of neuron type cells
+  CtmId _neurons_tot;
+
+  // Total number of muscle type cells
+  CtmId _muscles_tot;
+
+  // Current state
+  int8_t* _neuron_current;
+  int16_t* _muscle_current;
+
+  // Next state
+  int8_t* _neuron_next;
+  int16_t* _muscle_next;
+
+  // Number of ticks each neuron has been idle
+  uint8_t* _idle;
+
+  // Whether or not each neuron discharged this tick
+  uint8_t* _discharge;
+
+  // Connections decoded from the network's ROM words
+  const CtmSynapseTable* _synapses;
+
+} CtmEnsemble;
+
+// List of neurons to stimulate in a single instance
+typedef struct {
+  const CtmId* id;
+  CtmId len;
+} CtmStimulusList;
+
+// Function for initializing ensemble struct to simulate the
+// given network (which must outlive it); returns 0 if
+// memory runs out
+uint8_t ctm_ensemble_init(CtmEnsemble* const, const CtmNetwork* const, const uint16_t);
+
+// Releases the ensemble's state (which may be released
+// again)
+void ctm_ensemble_free(CtmEnsemble* const);
+
+// Completes one tick of every instance; accepts one
+// stimulus list per instance---otherwise NULL
+void ctm_ensemble_cycle(CtmEnsemble* const, const CtmStimulusList*);
+
+// Utility functions (instance, then cell id)
+
+int16_t ctm_ensemble_get_weight(CtmEnsemble* const, const uint16_t, const CtmId);
+uint8_t ctm_ensemble_get_discharge(CtmEnsemble* const, const uint16_t, const CtmId);
+void ctm_ensemble_discharge_query(CtmEnsemble* const, const uint16_t, const CtmId*, uint8_t*, const CtmId);
+
+#endif
+
+#endif
@@ -0,0 +1,220 @@
+#include "group.h"
+#include "muscles.h"
+
+static int ctm_group_compare_ids(const void* a, const void* b) {
+  const CtmId x = *(const CtmId*)a;
+  const CtmId y = *(const CtmId*)b;
+
+  return (x > y) - (x < y);
+}
+
+// Compile a group from a list of cell ids of the given
+// network; returns 0 if an id is out of range or memory
+// runs out
+uint8_t ctm_group_init(CtmGroup* const g, const CtmNetwork* const net, const CtmId* ids, const CtmId len) {
+  memset(g, 0, sizeof(*g));
+
+  CtmId lo = net->neurons;
+  CtmId hi = 0;
+
+  for(CtmId i = 0; i < len; i++) {
+    if(ids[i] >= net->cells) {
+      return 0;
+    }
+
+    if(ids[i] < net->neurons) {
+      lo = ids[i] < lo ? ids[i] : lo;
+      hi = ids[i] > hi ? ids[i] : hi;
+    }
+    else {
+      g->muscles++;
+    }
+  }
+
+  // Neurons
+  if(lo < net->neurons) {
+    g->_first = lo/CTM_BITS_PER_WORD;
+    g->_words = hi/CTM_BITS_PER_WORD - g->_first + 1;
+    g->_mask = calloc(g->_words, sizeof(CtmBitWord));
+
+    if(g->_mask == NULL) {
+      return 0;
+    }
+
+    const CtmId base = g->_first*CTM_BITS_PER_WORD;
+
+    for(CtmId i = 0; i < len; i++) {
+      if(ids[i] < net->neurons) {
+        ctm_bitset_set(g->_mask, ids[i] - base);
+      }
+    }
+
+    for(CtmId w = 0; w < g->_words; w++) {
+      g->neurons += __builtin_popcountll(g->_mask[w]);
+    }
+  }
+
+  // Muscles, sorted and merged into runs
+  if(g->muscles > 0) {
+    CtmId* offset = malloc(g->muscles*sizeof(CtmId));
+    g->_run_start = malloc(g->muscles*sizeof(CtmId));
+    g->_run_len = malloc(g->muscles*sizeof(CtmId));
+
+    if(offset == NULL || g->_run_start == NULL || g->_run_len == NULL) {
+      free(offset);
+      ctm_group_free(g);
+      return 0;
+    }
+
+    CtmId n = 0;
+
+    for(CtmId i = 0; i < len; i++) {
+      if(ids[i] >= net->neurons) {
+        offset[n++] = ids[i] - net->neurons;
+      }
+    }
+
+    qsort(offset, n, sizeof(CtmId), ctm_group_compare_ids);
+
+    g->muscles = 0;
+
+    for(CtmId i = 0; i < n; i++) {
+      if(i > 0 && offset[i] == offset[i - 1]) {
+        continue;
+      }
+
+      if(g->_runs > 0 && offset[i] == g->_run_start[g->_runs - 1] + g->_run_len[g->_runs - 1]) {
+        g->_run_len[g->_runs - 1]++;
+      }
+      else {
+        g->_run_start[g->_runs] = offset[i];
+        g->_run_len[g->_runs] = 1;
+        g->_runs++;
+      }
+
+      g->muscles++;
+    }
+
+    free(offset);
+  }
+
+  return 1;
+}
+
+void ctm_group_free(CtmGroup* const g) {
+  free(g->_mask);
+  free(g->_run_start);
+  free(g->_run_len);
+
+  memset(g, 0, sizeof(*g));
+}
+
+// Number of the group's neurons that discharged in the last
+// tick
+CtmId ctm_group_discharges(Connectome* const c, const CtmGroup* const g) {
+  CtmId count = 0;
+
+#ifdef CTM_FRONTIER
+  const CtmBitWord* const discharged = c->_discharged + g->_first;
+
+  for(CtmId w = 0; w < g->_words; w++) {
+    count += __builtin_popcountll(g->_mask[w] & discharged[w]);
+  }
+#else
+  const CtmId base = g->_first*CTM_BITS_PER_WORD;
+
+  for(CtmId w = 0; w < g->_words; w++) {
+    CtmBitWord bits = g->_mask[w];
+
+    while(bits) {
+      const CtmId id = base + w*CTM_BITS_PER_WORD + ctm_bitword_lowest(bits);
+      bits &= bits - 1;
+
+      count += ctm_get_discharge(c, id);
+    }
+  }
+#endif
+
+  return count;
+}
+
+// Percentage of the group's neurons that discharged in the
+// last tick
+uint8_t ctm_group_percent(Connectome* const c, const CtmGroup* const g) {
+  if(g->neurons == 0) {
+    return 0;
+  }
+
+  return (uint8_t)(100*(uint32_t)ctm_group_discharges(c, g)/g->neurons);
+}
+
+// Sum of the current states of the group's muscles
+int32_t ctm_group_muscle_sum(Connectome* const c, const CtmGroup* const g) {
+  const int16_t* const muscles = ctm_muscle_state(c);
+  int32_t sum = 0;
+
+  for(CtmId r = 0; r < g->_runs; r++) {
+    const int16_t* const run = muscles + g->_run_start[r];
+
+    for(CtmId i = 0; i < g->_run_len[r]; i++) {
+      sum += run[i];
+    }
+  }
+
+  return sum;
+}
+
+// Compile a group from a list kept in LARGE_CONST_ARR
+// memory; returns 0 if an id is out of range or memory
+// runs out
+uint8_t ctm_group_init_const(CtmGroup* const g, const CtmNetwork* const net, const CtmId* list, const CtmId len) {
+  CtmId* ids = malloc((len + 1)*sizeof(CtmId));
+
+  // The group is left empty, so that it can be freed
+  if(ids == NULL) {
+    memset(g, 0, sizeof(*g));
+    return 0;
+  }
+
+  for(CtmId i = 0; i < len; i++) {
+    ids[i] = READ_WORD(list, i);
+  }
+
+  const uint8_t ok = ctm_group_init(g, net, ids, len);
+
+  free(ids);
+
+  return ok;
+}
+
+// Compile every list in muscles.c; returns 0 if the
+// network is too small for them or memory runs out
+uint8_t ctm_body_groups_init(CtmBodyGroups* const b, const CtmNetwork* const net) {
+  uint8_t ok = ctm_group_init_const(&b->motor_a, net, motor_neuron_a, MOTOR_A);
+  ok &= ctm_group_init_const(&b->motor_b, net, motor_neuron_b, MOTOR_B);
+  ok &= ctm_group_init_const(&b->sig_motor_a, net, sig_motor_neuron_a, SIG_MOTOR_A);
+  ok &= ctm_group_init_const(&b->sig_motor_b, net, sig_motor_neuron_b, SIG_MOTOR_B);
+
+  ok &= ctm_group_init_const(&b->left_neck, net, left_neck_muscle, NECK_MUSCLES);
+  ok &= ctm_group_init_const(&b->right_neck, net, right_neck_muscle, NECK_MUSCLES);
+  ok &= ctm_group_init_const(&b->left_body, net, left_body_muscle, BODY_MUSCLES);
+  ok &= ctm_group_init_const(&b->right_body, net, right_body_muscle, BODY_MUSCLES);
+
+  if(!ok) {
+    ctm_body_groups_free(b);
+  }
+
+  return ok;
+}
+
+void ctm_body_groups_free(CtmBodyGroups* const b) {
+  ctm_group_free(&b->motor_a);
+  ctm_group_free(&b->motor_b);
+  ctm_group_free(&b->sig_motor_a);
+  ctm_group_free(&b->sig_motor_b);
+
+  ctm_group_free(&b->left_neck);
+  ctm_group_free(&b->right_neck);
+  ctm_group_free(&b->left_body);
+  ctm_group_free(&b->right_body);
+}
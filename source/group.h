@@ -0,0 +1,90 @@
+#ifndef GROUP_H
+#define GROUP_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "neural_rom.h"
+#include "network.h"
+#include "connectome.h"
+#include "bitset.h"
+
+//
+// Groups of cells precompiled for cheap per-tick readout
+//
+// Neuron members become a mask over the words of the
+// discharge bitset that they span, so a group's discharges
+// are counted with one AND and popcount per word. Muscle
+// members become runs of consecutive muscle ids, whose
+// states are summed.
+//
+// Builds without CTM_FRONTIER keep no discharge bitset,
+// and check the neurons in the mask one at a time.
+//
+
+typedef struct {
+  // Number of (distinct) neuron and muscle members
+  CtmId neurons;
+  CtmId muscles;
+
+  // Mask of neuron members over _words words of the
+  // discharge bitset, starting at word _first
+  CtmBitWord* _mask;
+  CtmId _first;
+  CtmId _words;
+
+  // Runs of muscle members, as offsets into the muscle
+  // state array and lengths
+  CtmId* _run_start;
+  CtmId* _run_len;
+  CtmId _runs;
+} CtmGroup;
+
+//
+// Groups for the lists in muscles.c (which use the ids of
+// the compiled-in network)
+//
+
+typedef struct {
+  CtmGroup motor_a;
+  CtmGroup motor_b;
+  CtmGroup sig_motor_a;
+  CtmGroup sig_motor_b;
+
+  CtmGroup left_neck;
+  CtmGroup right_neck;
+  CtmGroup left_body;
+  CtmGroup right_body;
+} CtmBodyGroups;
+
+// Compile a group from a list of cell ids of the given
+// network (duplicates are counted once); returns 0 if an id
+// is out of range or memory runs out
+uint8_t ctm_group_init(CtmGroup* const, const CtmNetwork* const, const CtmId*, const CtmId);
+
+// Compile a group from a list kept in LARGE_CONST_ARR
+// memory (such as the ones in muscles.c)
+uint8_t ctm_group_init_const(CtmGroup* const, const CtmNetwork* const, const CtmId*, const CtmId);
+
+void ctm_group_free(CtmGroup* const);
+
+// Number of the group's neurons that discharged in the last
+// tick
+CtmId ctm_group_discharges(Connectome* const, const CtmGroup* const);
+
+// Percentage (rounded down) of the group's neurons that
+// discharged in the last tick
+uint8_t ctm_group_percent(Connectome* const, const CtmGroup* const);
+
+// Sum of the current states of the group's muscles
+int32_t ctm_group_muscle_sum(Connectome* const, const CtmGroup* const);
+
+// Compile every list in muscles.c; returns 0 if the
+// network is too small for them or memory runs out
+uint8_t ctm_body_groups_init(CtmBodyGroups* const, const CtmNetwork* const);
+
+void ctm_body_groups_free(CtmBodyGroups* const);
+
+#endif
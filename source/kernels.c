@@ -0,0 +1,153 @@
+#include <string.h>
+
+#include "kernels.h"
+
+#ifdef CTM_FRONTIER
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CTM_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+//
+// Portable scalar kernels
+//
+// The vector kernels fall back on these for the
+// elements past their last full vector
+//
+
+static void above_from(const int8_t* state, const uint32_t start, const uint32_t n, const int8_t threshold, CtmBitWord* out) {
+  for(uint32_t i = start; i < n; i++) {
+    if(state[i] > threshold) {
+      ctm_bitset_set(out, i);
+    }
+  }
+}
+
+static void differ_from(const int8_t* a, const int8_t* b, const uint32_t start, const uint32_t n, CtmBitWord* out) {
+  for(uint32_t i = start; i < n; i++) {
+    if(a[i] != b[i]) {
+      ctm_bitset_set(out, i);
+    }
+  }
+}
+
+static void above_scalar(const int8_t* state, const uint32_t n, const int8_t threshold, CtmBitWord* out) {
+  ctm_bitset_clear(out, CTM_BITSET_WORDS(n));
+  above_from(state, 0, n, threshold, out);
+}
+
+static void differ_scalar(const int8_t* a, const int8_t* b, const uint32_t n, CtmBitWord* out) {
+  ctm_bitset_clear(out, CTM_BITSET_WORDS(n));
+  differ_from(a, b, 0, n, out);
+}
+
+static const CtmKernels kernels_scalar = {
+  above_scalar, differ_scalar
+};
+
+#ifdef CTM_KERNELS_X86
+
+//
+// SSE2 kernels (16 cells per step)
+//
+
+__attribute__((target("sse2")))
+static void above_sse2(const int8_t* state, const uint32_t n, const int8_t threshold, CtmBitWord* out) {
+  const __m128i t = _mm_set1_epi8(threshold);
+  uint32_t i = 0;
+
+  ctm_bitset_clear(out, CTM_BITSET_WORDS(n));
+
+  for(; i + 16 <= n; i += 16) {
+    const __m128i s = _mm_loadu_si128((const __m128i*)(state + i));
+    const CtmBitWord bits = (uint16_t)_mm_movemask_epi8(_mm_cmpgt_epi8(s, t));
+
+    out[i/CTM_BITS_PER_WORD] |= bits << (i % CTM_BITS_PER_WORD);
+  }
+
+  above_from(state, i, n, threshold, out);
+}
+
+__attribute__((target("sse2")))
+static void differ_sse2(const int8_t* a, const int8_t* b, const uint32_t n, CtmBitWord* out) {
+  uint32_t i = 0;
+
+  ctm_bitset_clear(out, CTM_BITSET_WORDS(n));
+
+  for(; i + 16 <= n; i += 16) {
+    const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    const CtmBitWord bits = (uint16_t)~_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+
+    out[i/CTM_BITS_PER_WORD] |= bits << (i % CTM_BITS_PER_WORD);
+  }
+
+  differ_from(a, b, i, n, out);
+}
+
+static const CtmKernels kernels_sse2 = {
+  above_sse2, differ_sse2
+};
+
+//
+// AVX2 kernels (32 cells per step)
+//
+
+__attribute__((target("avx2")))
+static void above_avx2(const int8_t* state, const uint32_t n, const int8_t threshold, CtmBitWord* out) {
+  const __m256i t = _mm256_set1_epi8(threshold);
+  uint32_t i = 0;
+
+  ctm_bitset_clear(out, CTM_BITSET_WORDS(n));
+
+  for(; i + 32 <= n; i += 32) {
+    const __m256i s = _mm256_loadu_si256((const __m256i*)(state + i));
+    const CtmBitWord bits = (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(s, t));
+
+    out[i/CTM_BITS_PER_WORD] |= bits << (i % CTM_BITS_PER_WORD);
+  }
+
+  above_from(state, i, n, threshold, out);
+}
+
+__attribute__((target("avx2")))
+static void differ_avx2(const int8_t* a, const int8_t* b, const uint32_t n, CtmBitWord* out) {
+  uint32_t i = 0;
+
+  ctm_bitset_clear(out, CTM_BITSET_WORDS(n));
+
+  for(; i + 32 <= n; i += 32) {
+    const __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+    const __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+    const CtmBitWord bits = (uint32_t)~_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+
+    out[i/CTM_BITS_PER_WORD] |= bits << (i % CTM_BITS_PER_WORD);
+  }
+
+  differ_from(a, b, i, n, out);
+}
+
+static const CtmKernels kernels_avx2 = {
+  above_avx2, differ_avx2
+};
+
+#endif
+
+// Returns the kernels best suited to this CPU
+const CtmKernels* ctm_kernels(void) {
+#ifdef CTM_KERNELS_X86
+  __builtin_cpu_init();
+
+  if(__builtin_cpu_supports("avx2")) {
+    return &kernels_avx2;
+  }
+  else if(__builtin_cpu_supports("sse2")) {
+    return &kernels_sse2;
+  }
+#endif
+
+  return &kernels_scalar;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>
+
+#include "defines.h"
+#include "bitset.h"
+
+#ifdef CTM_FRONTIER
+
+//
+// Whole-array kernels over cell state arrays
+//
+// Each kernel has a portable scalar version and, on x86,
+// SSE2 and AVX2 versions; ctm_kernels() picks the widest
+// one the running CPU supports
+//
+
+typedef struct {
+  // Sets bit i of the bitset for each state[i] > threshold,
+  // clears the rest
+  void (*above)(const int8_t*, const uint32_t, const int8_t, CtmBitWord*);
+
+  // Sets bit i of the bitset for each a[i] != b[i],
+  // clears the rest
+  void (*differ)(const int8_t*, const int8_t*, const uint32_t, CtmBitWord*);
+} CtmKernels;
+
+// Returns the kernels best suited to this CPU
+const CtmKernels* ctm_kernels(void);
+
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+#include "locomotion.h"
+#include "muscles.h"
+
+// Fill in the parameters of motor_avg_plot.py
+void ctm_locomotion_default_params(CtmLocomotionParams* const p) {
+  p->window = 15;
+  p->source = CTM_LOCOMOTION_FULL;
+  p->reverse_on = 19;
+  p->reverse_off = 19;
+}
+
+// Set up a decoder for a network numbered like the
+// compiled-in one; returns 0 if the network is too small or
+// the parameters are invalid
+uint8_t ctm_locomotion_init(CtmLocomotion* const l, const CtmNetwork* const net, const CtmLocomotionParams* const p) {
+  memset(l, 0, sizeof(*l));
+
+  if(p->reverse_off > p->reverse_on || p->reverse_on > 100 || p->source > CTM_LOCOMOTION_SIG) {
+    return 0;
+  }
+
+  l->params = *p;
+  l->state = CTM_LOCOMOTION_FORWARD;
+
+  uint8_t ok = ctm_group_init_const(&l->_motor_a, net, motor_neuron_a, MOTOR_A);
+  ok &= ctm_group_init_const(&l->_motor_b, net, motor_neuron_b, MOTOR_B);
+  ok &= ctm_group_init_const(&l->_sig_motor_a, net, sig_motor_neuron_a, SIG_MOTOR_A);
+  ok &= ctm_group_init_const(&l->_sig_motor_b, net, sig_motor_neuron_b, SIG_MOTOR_B);
+
+  if(!ok) {
+    ctm_locomotion_free(l);
+  }
+
+  return ok;
+}
+
+void ctm_locomotion_free(CtmLocomotion* const l) {
+  ctm_group_free(&l->_motor_a);
+  ctm_group_free(&l->_motor_b);
+  ctm_group_free(&l->_sig_motor_a);
+  ctm_group_free(&l->_sig_motor_b);
+}
+
+// Percentage of a group firing, in 1/256ths of a percent
+static uint16_t ctm_locomotion_percent(Connectome* const c, const CtmGroup* const g) {
+  if(g->neurons == 0) {
+    return 0;
+  }
+
+  return (uint16_t)(((uint32_t)ctm_group_discharges(c, g)*100*256 + g->neurons/2)/g->neurons);
+}
+
+// Fold one tick's percentage into a moving average
+// (rounded to nearest)
+static uint16_t ctm_locomotion_average(const uint16_t avg, const uint16_t percent, const uint8_t window) {
+  const uint32_t n = (uint32_t)window + 1;
+
+  return (uint16_t)((percent + (uint32_t)window*avg + n/2)/n);
+}
+
+// Update a decoder with the last tick's discharges
+void ctm_locomotion_update(CtmLocomotion* const l, Connectome* const c) {
+  const uint16_t a = ctm_locomotion_percent(c, &l->_motor_a);
+  const uint16_t b = ctm_locomotion_percent(c, &l->_motor_b);
+  const uint16_t sig_a = ctm_locomotion_percent(c, &l->_sig_motor_a);
+  const uint16_t sig_b = ctm_locomotion_percent(c, &l->_sig_motor_b);
+
+  if(!l->_seeded) {
+    l->avg_a = a;
+    l->avg_b = b;
+    l->avg_sig_a = sig_a;
+    l->avg_sig_b = sig_b;
+    l->_seeded = 1;
+  }
+  else {
+    const uint8_t window = l->params.window;
+
+    l->avg_a = ctm_locomotion_average(l->avg_a, a, window);
+    l->avg_b = ctm_locomotion_average(l->avg_b, b, window);
+    l->avg_sig_a = ctm_locomotion_average(l->avg_sig_a, sig_a, window);
+    l->avg_sig_b = ctm_locomotion_average(l->avg_sig_b, sig_b, window);
+  }
+
+  const uint16_t avg = l->params.source == CTM_LOCOMOTION_SIG ? l->avg_sig_a : l->avg_a;
+
+  if(avg > (uint16_t)l->params.reverse_on*256) {
+    l->state = CTM_LOCOMOTION_REVERSE;
+  }
+  else if(avg < (uint16_t)l->params.reverse_off*256) {
+    l->state = CTM_LOCOMOTION_FORWARD;
+  }
+}
+
+// Observer callback that updates the decoder given as its
+// argument
+uint8_t ctm_locomotion_observe(Connectome* const c, const uint64_t ticks, void* l) {
+  (void)ticks;
+
+  ctm_locomotion_update(l, c);
+
+  return 1;
+}
@@ -0,0 +1,96 @@
+#ifndef LOCOMOTION_H
+#define LOCOMOTION_H
+
+#include <stdint.h>
+
+#include "defines.h"
+#include "network.h"
+#include "connectome.h"
+#include "group.h"
+
+//
+// Streaming forward/reverse locomotion decoder
+//
+// Keeps exponential moving averages of the percentage of
+// A-type and B-type motor neurons firing (full groups and
+// the significant ones in muscles.c), as plotted by
+// python_plotting/motor_avg_plot.py:
+//
+// avg = (percent + window*avg)/(window + 1)
+//
+// Averages are fixed point, in 1/256ths of a percent, and
+// seeded with the first tick's percentages. The decoder
+// switches to reverse when the A-type average rises above
+// reverse_on percent, and back to forward when it falls
+// below reverse_off percent (set it lower for hysteresis).
+//
+// The decoder is updated by calling ctm_locomotion_update
+// after each tick, or by running ctm_locomotion_observe as
+// a ctm_run observer (with a stride of one and the decoder
+// as its argument), so the core simulation never depends
+// on it.
+//
+
+#define CTM_LOCOMOTION_FORWARD 0
+#define CTM_LOCOMOTION_REVERSE 1
+
+// Motor groups that drive the decision
+#define CTM_LOCOMOTION_FULL 0
+#define CTM_LOCOMOTION_SIG 1
+
+typedef struct {
+  // Moving average window (WINDOW in motor_avg_plot.py)
+  uint8_t window;
+
+  // Motor groups that drive the decision
+  // (CTM_LOCOMOTION_*)
+  uint8_t source;
+
+  // A-type percentages at which to switch to reverse, and
+  // back to forward
+  uint8_t reverse_on;
+  uint8_t reverse_off;
+} CtmLocomotionParams;
+
+typedef struct {
+  CtmLocomotionParams params;
+
+  // Moving averages of the percentage of each group firing
+  // (in 1/256ths of a percent)
+  uint16_t avg_a;
+  uint16_t avg_b;
+  uint16_t avg_sig_a;
+  uint16_t avg_sig_b;
+
+  // Current decision (CTM_LOCOMOTION_FORWARD or
+  // CTM_LOCOMOTION_REVERSE)
+  uint8_t state;
+
+  // Whether the averages have been seeded
+  uint8_t _seeded;
+
+  CtmGroup _motor_a;
+  CtmGroup _motor_b;
+  CtmGroup _sig_motor_a;
+  CtmGroup _sig_motor_b;
+} CtmLocomotion;
+
+// Fills in the parameters of motor_avg_plot.py (a window
+// of 15 and a reverse threshold of 19 percent)
+void ctm_locomotion_default_params(CtmLocomotionParams* const);
+
+// Sets up a decoder for a network numbered like the
+// compiled-in one; returns 0 if the network is too small or
+// the parameters are invalid
+uint8_t ctm_locomotion_init(CtmLocomotion* const, const CtmNetwork* const, const CtmLocomotionParams* const);
+
+void ctm_locomotion_free(CtmLocomotion* const);
+
+// Updates a decoder with the last tick's discharges
+void ctm_locomotion_update(CtmLocomotion* const, Connectome* const);
+
+// Observer callback (see CtmObserverFn) that updates the
+// decoder given as its argument; never ends the run
+uint8_t ctm_locomotion_observe(Connectome* const, const uint64_t, void*);
+
+#endif
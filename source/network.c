@@ -0,0 +1,531 @@
+#include "network.h"
+
+#ifdef CTM_NETWORK_FILE
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef CTM_SYNAPSE_TABLE
+// 64-bit FNV-1a, fed a value at a time
+static uint64_t ctm_hash_u32(uint64_t h, const uint32_t val) {
+  for(uint8_t i = 0; i < 4; i++) {
+    h ^= (val >> (8*i)) & 0xFF;
+    h *= 0x100000001B3ull;
+  }
+
+  return h;
+}
+
+// Hash the cell counts and decoded connections
+static uint64_t ctm_network_hash_table(const CtmNetwork* const net) {
+  const CtmSynapseTable* const t = &net->_synapses;
+  uint64_t h = 0xCBF29CE484222325ull;
+
+  h = ctm_hash_u32(h, net->cells);
+  h = ctm_hash_u32(h, net->neurons);
+
+  for(CtmId row = 0; row < t->rows; row++) {
+    h = ctm_hash_u32(h, t->row_offset[row + 1] - t->row_offset[row]);
+
+    for(uint32_t i = t->row_offset[row]; i < t->row_offset[row + 1]; i++) {
+      h = ctm_hash_u32(h, t->target[i]);
+      h = ctm_hash_u32(h, (uint32_t)(int32_t)t->weight[i]);
+    }
+  }
+
+  return h;
+}
+#endif
+
+// Decode the connection tables shared by every simulation
+// of the network; returns 0 if the connections are malformed
+// or memory runs out
+static uint8_t ctm_network_tables_init(CtmNetwork* const net) {
+#ifdef CTM_SYNAPSE_TABLE
+  if(net->encoding == CTM_ENCODING_COMPACT) {
+    if(!ctm_synapse_table_init(&net->_synapses, net->rom)) {
+      return 0;
+    }
+  }
+#ifdef CTM_WIDE_NETWORKS
+  else if(!ctm_synapse_table_init_wide(&net->_synapses, net->wide_index, net->wide_data, net->wide_size, net->neurons, net->cells, net->wide_len)) {
+    return 0;
+  }
+#endif
+
+  net->_hash = ctm_network_hash_table(net);
+#else
+  (void)net;
+#endif
+
+#ifdef CTM_FRONTIER
+  if(!ctm_reverse_table_init(&net->_reverse, &net->_synapses, net->cells)) {
+    ctm_synapse_table_free(&net->_synapses);
+    return 0;
+  }
+#endif
+
+  return 1;
+}
+
+// Set up a handle to the compiled-in network; returns 0 if
+// memory runs out
+uint8_t ctm_network_builtin(CtmNetwork* const net) {
+  net->cells = CELLS;
+  net->neurons = READ_WORD(NEURAL_ROM, 0);
+  net->encoding = CTM_ENCODING_COMPACT;
+  net->rom = NEURAL_ROM;
+
+#ifdef CTM_WIDE_NETWORKS
+  net->wide_index = NULL;
+  net->wide_data = NULL;
+  net->wide_size = 0;
+  net->wide_len = 0;
+#endif
+
+#ifdef CTM_NETWORK_FILE
+  net->names = &CELL_NAMES[0][0];
+  net->name_len = CTM_NAME_LEN;
+
+  net->_map = NULL;
+  net->_map_len = 0;
+#else
+  net->names = NULL;
+  net->name_len = 0;
+#endif
+
+  return ctm_network_tables_init(net);
+}
+
+#ifdef CTM_SYNAPSE_TABLE
+// Set up a handle to a network built in memory, taking
+// over its synapse table (which is released if memory runs
+// out, returning 0); the name table (if any) must outlive
+// the handle
+uint8_t ctm_network_from_table(CtmNetwork* const net, const CtmSynapseTable* const t, const CtmId cells, const char* names, const uint32_t name_len) {
+  net->cells = cells;
+  net->neurons = t->rows;
+
+  // There are no encoded connections, only the table
+  net->encoding = CTM_ENCODING_WIDE;
+  net->rom = NULL;
+
+#ifdef CTM_WIDE_NETWORKS
+  net->wide_index = NULL;
+  net->wide_data = NULL;
+  net->wide_size = 0;
+  net->wide_len = 0;
+#endif
+
+  net->names = names;
+  net->name_len = names != NULL ? name_len : 0;
+
+#ifdef CTM_NETWORK_FILE
+  net->_map = NULL;
+  net->_map_len = 0;
+#endif
+
+  net->_synapses = *t;
+  net->_hash = ctm_network_hash_table(net);
+
+#ifdef CTM_FRONTIER
+  if(!ctm_reverse_table_init(&net->_reverse, &net->_synapses, net->cells)) {
+    ctm_synapse_table_free(&net->_synapses);
+    return 0;
+  }
+#endif
+
+  return 1;
+}
+#endif
+
+#ifdef CTM_NETWORK_FILE
+
+// Layout of version 1 headers
+typedef struct {
+  char magic[4];
+  uint16_t version;
+  uint16_t name_len;
+  uint16_t cells;
+  uint16_t neurons;
+  uint32_t name_offset;
+  uint32_t rom_offset;
+  uint32_t rom_words;
+} CtmNetworkHeaderV1;
+
+// Read the header of a mapped file of the given length
+// into the current layout; returns 0 if it isn't one
+static uint8_t ctm_network_read_header(const void* map, const size_t len, CtmNetworkHeader* const h) {
+  if(len < sizeof(CtmNetworkHeaderV1) || memcmp(map, CTM_NETWORK_MAGIC, 4) != 0) {
+    return 0;
+  }
+
+  memcpy(&h->version, (const uint8_t*)map + 4, sizeof(h->version));
+
+  if(h->version == 1) {
+    CtmNetworkHeaderV1 v1;
+    memcpy(&v1, map, sizeof(v1));
+
+    h->encoding = CTM_ENCODING_COMPACT;
+    h->cells = v1.cells;
+    h->neurons = v1.neurons;
+    h->connections = v1.rom_words - ((uint32_t)v1.neurons + 2);
+    h->name_len = v1.name_len;
+    h->name_offset = v1.name_offset;
+    h->data_offset = v1.rom_offset;
+    h->data_size = v1.rom_words*sizeof(uint16_t);
+
+    return v1.rom_words <= UINT32_MAX/sizeof(uint16_t);
+  }
+  else if(h->version == CTM_NETWORK_VERSION && len >= sizeof(CtmNetworkHeader)) {
+    memcpy(h, map, sizeof(*h));
+    return 1;
+  }
+
+  return 0;
+}
+
+// Check that ROM words index only their own connection
+// words, and only connect to cells that exist
+static uint8_t ctm_network_rom_valid(const uint16_t* rom, const uint32_t words, const CtmId neurons, const CtmId cells) {
+  if(words < (uint32_t)neurons + 2 || rom[0] != neurons) {
+    return 0;
+  }
+
+  if(rom[1] != neurons + 2 || rom[neurons + 1] != words) {
+    return 0;
+  }
+
+  for(CtmId i = 1; i <= neurons; i++) {
+    if(rom[i + 1] < rom[i]) {
+      return 0;
+    }
+  }
+
+  for(uint32_t i = neurons + 2; i < words; i++) {
+    if(parse_rom_word(rom[i]).id >= cells) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+// Point the handle at the connections in a mapped file;
+// returns 0 if they don't fit the header (wide connections
+// are checked as they are decoded)
+static uint8_t ctm_network_map_data(CtmNetwork* const net, const CtmNetworkHeader* const h, const uint8_t* data) {
+  net->rom = NULL;
+
+#ifdef CTM_WIDE_NETWORKS
+  net->wide_index = NULL;
+  net->wide_data = NULL;
+  net->wide_size = 0;
+  net->wide_len = 0;
+#endif
+
+  if(h->encoding == CTM_ENCODING_COMPACT) {
+    const uint32_t words = h->data_size/sizeof(uint16_t);
+
+    if(h->data_offset % sizeof(uint16_t) != 0 || words != (uint64_t)h->neurons + 2 + h->connections) {
+      return 0;
+    }
+
+    net->rom = (const uint16_t*)data;
+
+    return ctm_network_rom_valid(net->rom, words, h->neurons, h->cells);
+  }
+#ifdef CTM_WIDE_NETWORKS
+  else if(h->encoding == CTM_ENCODING_WIDE) {
+    const uint64_t index_size = ((uint64_t)h->neurons + 1)*sizeof(uint32_t);
+
+    if(h->data_offset % sizeof(uint32_t) != 0 || index_size > h->data_size) {
+      return 0;
+    }
+
+    // Every connection takes at least three bytes
+    if(h->connections > (h->data_size - index_size)/3) {
+      return 0;
+    }
+
+    net->wide_index = (const uint32_t*)data;
+    net->wide_data = data + index_size;
+    net->wide_size = h->data_size - (uint32_t)index_size;
+    net->wide_len = h->connections;
+
+    return 1;
+  }
+#endif
+
+  return 0;
+}
+
+// Map a binary connectome file read-only; returns 0 if
+// the file can't be read or isn't a valid connectome
+uint8_t ctm_network_open(CtmNetwork* const net, const char* path) {
+  // Words are read straight from the mapping, so they must
+  // already be in host byte order
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  return 0;
+#endif
+
+  const int fd = open(path, O_RDONLY);
+
+  if(fd < 0) {
+    return 0;
+  }
+
+  struct stat st;
+
+  if(fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return 0;
+  }
+
+  // Names are used straight from the mapping, while the
+  // connections are decoded into tables private to this
+  // handle (see ctm_network_tables_init)
+  const size_t len = (size_t)st.st_size;
+  void* map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+
+  close(fd);
+
+  if(map == MAP_FAILED) {
+    return 0;
+  }
+
+  const uint8_t* const bytes = map;
+  CtmNetworkHeader h;
+
+  uint8_t valid = ctm_network_read_header(map, len, &h)
+    && (CtmId)h.cells == h.cells
+    && h.neurons <= h.cells
+    && h.data_offset <= len
+    && h.data_size <= len - h.data_offset
+    && h.name_offset <= len
+    && (uint64_t)h.cells*h.name_len <= len - h.name_offset;
+
+  if(valid) {
+    net->cells = h.cells;
+    net->neurons = h.neurons;
+    net->encoding = (uint8_t)h.encoding;
+
+    valid = h.encoding == net->encoding && ctm_network_map_data(net, &h, bytes + h.data_offset);
+  }
+
+  // Names have to be terminated within their entry
+  for(CtmId i = 0; valid && h.name_len > 0 && i < h.cells; i++) {
+    valid = bytes[h.name_offset + (uint64_t)(i + 1)*h.name_len - 1] == '\0';
+  }
+
+  if(valid) {
+    net->names = h.name_len > 0 ? (const char*)(bytes + h.name_offset) : NULL;
+    net->name_len = h.name_len;
+
+    net->_map = map;
+    net->_map_len = len;
+
+    valid = ctm_network_tables_init(net);
+  }
+
+  if(!valid) {
+    munmap(map, len);
+    net->_map = NULL;
+    return 0;
+  }
+
+  return 1;
+}
+
+// Encode a network's connections as they are stored in a
+// file; returns a buffer to be freed by the caller, or NULL
+// if they don't fit the encoding or it can't be allocated
+void* ctm_network_encode(const CtmNetwork* const net, const uint8_t encoding, uint32_t* const size) {
+  const CtmSynapseTable* const t = &net->_synapses;
+
+  if(encoding == CTM_ENCODING_COMPACT) {
+    // Ids have nine bits, and ROM addresses sixteen
+    if(net->cells > 512 || (uint64_t)t->rows + 2 + t->len > UINT16_MAX) {
+      return NULL;
+    }
+
+    const uint32_t words = t->rows + 2 + t->len;
+    uint16_t* rom = malloc(words*sizeof(uint16_t));
+
+    if(rom == NULL) {
+      return NULL;
+    }
+
+    rom[0] = (uint16_t)t->rows;
+
+    for(CtmId i = 0; i <= t->rows; i++) {
+      rom[i + 1] = (uint16_t)(t->rows + 2 + t->row_offset[i]);
+    }
+
+    for(uint32_t i = 0; i < t->len; i++) {
+      if(t->weight[i] < -64 || t->weight[i] > 63) {
+        free(rom);
+        return NULL;
+      }
+
+      rom[t->rows + 2 + i] = make_rom_word((uint16_t)t->target[i], (int8_t)t->weight[i]);
+    }
+
+    *size = words*sizeof(uint16_t);
+    return rom;
+  }
+#ifdef CTM_WIDE_NETWORKS
+  else if(encoding == CTM_ENCODING_WIDE) {
+    const size_t index_size = ((size_t)t->rows + 1)*sizeof(uint32_t);
+    uint8_t* buf = malloc(index_size + (size_t)t->len*CTM_WIDE_MAX_BYTES);
+
+    if(buf == NULL) {
+      return NULL;
+    }
+
+    uint32_t* const index = (uint32_t*)buf;
+    uint8_t* const data = buf + index_size;
+    uint32_t n = 0;
+
+    for(CtmId row = 0; row < t->rows; row++) {
+      CtmId prev = 0;
+
+      index[row] = n;
+
+      for(uint32_t i = t->row_offset[row]; i < t->row_offset[row + 1]; i++) {
+        n += ctm_wide_put(data + n, prev, t->target[i], t->weight[i]);
+        prev = t->target[i];
+      }
+    }
+
+    index[t->rows] = n;
+
+    *size = (uint32_t)index_size + n;
+    return buf;
+  }
+#endif
+
+  return NULL;
+}
+
+// Write a network out as a binary connectome file with
+// connections in the given encoding; returns 0 on failure
+// (including connections that the encoding can't hold)
+uint8_t ctm_network_save(const CtmNetwork* const net, const char* path, const uint8_t encoding) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  return 0;
+#endif
+
+  const uint32_t name_len = net->names != NULL ? net->name_len : 0;
+  const uint32_t names_size = net->cells*name_len;
+
+  CtmNetworkHeader h;
+  memset(&h, 0, sizeof(h));
+
+  memcpy(h.magic, CTM_NETWORK_MAGIC, 4);
+  h.version = CTM_NETWORK_VERSION;
+  h.encoding = encoding;
+  h.cells = net->cells;
+  h.neurons = net->neurons;
+  h.connections = net->_synapses.len;
+  h.name_len = name_len;
+  h.name_offset = sizeof(h);
+  h.data_offset = (h.name_offset + names_size + 3) & ~(uint32_t)3;
+
+  void* data = ctm_network_encode(net, encoding, &h.data_size);
+
+  if(data == NULL) {
+    return 0;
+  }
+
+  FILE* f = fopen(path, "wb");
+
+  if(f == NULL) {
+    free(data);
+    return 0;
+  }
+
+  uint8_t ok = fwrite(&h, sizeof(h), 1, f) == 1;
+
+  if(ok && names_size > 0) {
+    ok = fwrite(net->names, names_size, 1, f) == 1;
+  }
+
+  for(uint32_t i = h.name_offset + names_size; ok && i < h.data_offset; i++) {
+    ok = fputc(0, f) != EOF;
+  }
+
+  if(ok) {
+    ok = fwrite(data, h.data_size, 1, f) == 1;
+  }
+
+  if(fclose(f) != 0) {
+    ok = 0;
+  }
+
+  free(data);
+
+  return ok;
+}
+
+#endif
+
+// Release anything the handle holds (no simulation may
+// use it afterwards)
+void ctm_network_close(CtmNetwork* const net) {
+#ifdef CTM_SYNAPSE_TABLE
+  ctm_synapse_table_free(&net->_synapses);
+#endif
+
+#ifdef CTM_FRONTIER
+  ctm_reverse_table_free(&net->_reverse);
+#endif
+
+#ifdef CTM_NETWORK_FILE
+  if(net->_map != NULL) {
+    munmap(net->_map, net->_map_len);
+    net->_map = NULL;
+  }
+#endif
+
+  net->rom = NULL;
+  net->names = NULL;
+}
+
+
+#ifdef CTM_SYNAPSE_TABLE
+// Hash of a network's cell counts and connections (the
+// same whatever encoding they were loaded from)
+uint64_t ctm_network_hash(const CtmNetwork* const net) {
+  return net->_hash;
+}
+#endif
+
+// Name of a cell, or NULL if the network has no names
+const char* ctm_network_cell_name(const CtmNetwork* const net, const CtmId id) {
+  if(net->names == NULL || id >= net->cells) {
+    return NULL;
+  }
+
+  return net->names + (size_t)id*net->name_len;
+}
+
+// Look up a cell by name; returns 0 if there is no such
+// cell
+uint8_t ctm_network_find_cell(const CtmNetwork* const net, const char* name, CtmId* id) {
+  if(net->names == NULL) {
+    return 0;
+  }
+
+  for(CtmId i = 0; i < net->cells; i++) {
+    if(strncmp(ctm_network_cell_name(net, i), name, net->name_len) == 0) {
+      *id = i;
+      return 1;
+    }
+  }
+
+  return 0;
+}
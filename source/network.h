@@ -0,0 +1,184 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "neural_rom.h"
+#include "synapse_table.h"
+
+//
+// Handle to a connectome's wiring, shared by any number of
+// simulations
+//
+// The wiring either comes from the compiled-in NEURAL_ROM
+// or is loaded from a binary connectome file
+//
+
+//
+// Connection encodings
+//
+
+// 16-bit ROM words as in NEURAL_ROM (up to 512 cells,
+// weights of -64 to 63)
+#define CTM_ENCODING_COMPACT 0
+
+// Delta-coded varint ids and 16-bit weights (see
+// wide_rom.h)
+#define CTM_ENCODING_WIDE 1
+
+typedef struct {
+  // Total number of cells, and how many of them are
+  // neurons (i.e. have outgoing connections)
+  CtmId cells;
+  CtmId neurons;
+
+  // How connections are encoded (CTM_ENCODING_*)
+  uint8_t encoding;
+
+  // Compact encoding: offset index and connection words,
+  // laid out as in NEURAL_ROM
+  const uint16_t* rom;
+
+#ifdef CTM_WIDE_NETWORKS
+  // Wide encoding: index of each neuron's run, the runs,
+  // their total size in bytes, and the number of
+  // connections
+  const uint32_t* wide_index;
+  const uint8_t* wide_data;
+  uint32_t wide_size;
+  uint32_t wide_len;
+#endif
+
+  // Cell names, name_len bytes each and NUL padded, in
+  // id order (NULL if the network has none)
+  const char* names;
+  uint32_t name_len;
+
+#ifdef CTM_SYNAPSE_TABLE
+  // Decoded connections, and their hash (see
+  // ctm_network_hash)
+  CtmSynapseTable _synapses;
+  uint64_t _hash;
+#endif
+
+#ifdef CTM_FRONTIER
+  // Incoming connections of every cell
+  CtmReverseTable _reverse;
+#endif
+
+#ifdef CTM_NETWORK_FILE
+  // Mapping of the file the network was loaded from
+  // (NULL for the compiled-in network)
+  void* _map;
+  size_t _map_len;
+#endif
+
+} CtmNetwork;
+
+#ifdef CTM_NETWORK_FILE
+
+//
+// Binary connectome files
+//
+// All fields are little-endian, offsets are in bytes from
+// the start of the file:
+//
+// Bytes 0-3: Magic number ("CTMN")
+// Bytes 4-5: Format version (CTM_NETWORK_VERSION)
+// Bytes 6-7: Connection encoding (CTM_ENCODING_*)
+// Bytes 8-11: Number of cells
+// Bytes 12-15: Number of neurons
+// Bytes 16-19: Number of connections
+// Bytes 20-23: Width of each name table entry
+// Bytes 24-27: Offset of the name table (one entry per cell)
+// Bytes 28-31: Offset of the connection data
+// Bytes 32-35: Size of the connection data
+//
+// Compact connection data are ROM words: the offset index
+// and connection words, formatted as in NEURAL_ROM. Wide
+// connection data are the run index, (neurons + 1) 32-bit
+// offsets, followed by the runs themselves. Either is read
+// straight from the mapped file, so it must be aligned to
+// its word size; it is decoded into connection tables
+// that each handle holds privately.
+//
+// Version 1 files hold compact connections only, with a
+// shorter header (read, but no longer written):
+//
+// Bytes 6-7: Width of each name table entry
+// Bytes 8-9: Number of cells
+// Bytes 10-11: Number of neurons
+// Bytes 12-15: Offset of the name table
+// Bytes 16-19: Offset of the ROM words
+// Bytes 20-23: Number of ROM words
+//
+
+#define CTM_NETWORK_MAGIC "CTMN"
+#define CTM_NETWORK_VERSION 2
+
+typedef struct {
+  char magic[4];
+  uint16_t version;
+  uint16_t encoding;
+  uint32_t cells;
+  uint32_t neurons;
+  uint32_t connections;
+  uint32_t name_len;
+  uint32_t name_offset;
+  uint32_t data_offset;
+  uint32_t data_size;
+} CtmNetworkHeader;
+
+#endif
+
+// Set up a handle to the compiled-in network; returns 0 if
+// its connection tables can't be allocated
+uint8_t ctm_network_builtin(CtmNetwork* const);
+
+#ifdef CTM_SYNAPSE_TABLE
+// Set up a handle to a network built in memory, taking
+// over its synapse table (which is released if memory runs
+// out, returning 0); the name table (if any) must outlive
+// the handle
+uint8_t ctm_network_from_table(CtmNetwork* const, const CtmSynapseTable* const, const CtmId, const char*, const uint32_t);
+#endif
+
+#ifdef CTM_NETWORK_FILE
+// Map a binary connectome file read-only; returns 0 if
+// the file can't be read, isn't a valid connectome or
+// memory runs out
+uint8_t ctm_network_open(CtmNetwork* const, const char*);
+
+// Write a network out as a binary connectome file with
+// connections in the given encoding; returns 0 on failure
+// (including connections that the encoding can't hold)
+uint8_t ctm_network_save(const CtmNetwork* const, const char*, const uint8_t);
+
+// Encode a network's connections as they are stored in a
+// file, setting the size in bytes; returns a buffer to be
+// freed by the caller, or NULL if they don't fit the
+// encoding or it can't be allocated
+void* ctm_network_encode(const CtmNetwork* const, const uint8_t, uint32_t* const);
+#endif
+
+// Release anything the handle holds (no simulation may
+// use it afterwards)
+void ctm_network_close(CtmNetwork* const);
+
+#ifdef CTM_SYNAPSE_TABLE
+// Hash of a network's cell counts and connections (the
+// same whatever encoding they were loaded from)
+uint64_t ctm_network_hash(const CtmNetwork* const);
+#endif
+
+// Name of a cell, or NULL if the network has no names
+const char* ctm_network_cell_name(const CtmNetwork* const, const CtmId);
+
+// Look up a cell by name; returns 0 if there is no such
+// cell
+uint8_t ctm_network_find_cell(const CtmNetwork* const, const char*, CtmId*);
+
+#endif
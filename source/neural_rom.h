@@ -17,4 +17,68 @@
 
 extern const uint16_t LARGE_CONST_ARR NEURAL_ROM[];
 
+//
+// Types for cell ids (and counts of cells), connection
+// weights, and sums of a state and a weight
+//
+// Microcontrollers only use the ROM format above, which
+// fits the narrow types
+//
+
+#ifdef CTM_WIDE_NETWORKS
+typedef uint32_t CtmId;
+typedef int16_t CtmWeight;
+typedef int32_t CtmSum;
+#else
+typedef uint16_t CtmId;
+typedef int8_t CtmWeight;
+typedef int16_t CtmSum;
+#endif
+
+#ifdef CTM_NETWORK_FILE
+// Width of each entry in the cell name table
+#define CTM_NAME_LEN 8
+
+// Cell names in id order, NUL padded
+extern const char CELL_NAMES[][CTM_NAME_LEN];
+#endif
+
+//
+// Utilities for parsing a ROM word into a connection
+// with an id and weight
+//
+
+// Struct for representing a neuron connection
+typedef struct {
+  uint16_t id;
+  int8_t weight;
+} NeuronConnection;
+
+static inline NeuronConnection parse_rom_word(uint16_t rom_word) {
+  uint8_t* rom_byte;
+  rom_byte = (uint8_t*)&rom_word;
+
+  uint16_t id = rom_byte[1] + ((rom_byte[0] & 0b10000000) << 1);
+  
+  uint8_t weight_bits = rom_byte[0] & 0b01111111;
+  weight_bits = weight_bits + ((weight_bits & 0b01000000) << 1);
+  int8_t weight = (int8_t)weight_bits;
+
+  NeuronConnection neuron_conn = {id, weight};
+
+  return neuron_conn;
+}
+
+// Inverse of parse_rom_word (weight must be within -64 to 63)
+static inline uint16_t make_rom_word(const uint16_t id, const int8_t weight) {
+  uint16_t rom_word;
+  uint8_t* rom_byte;
+  rom_byte = (uint8_t*)&rom_word;
+
+  rom_byte[0] = ((uint8_t)weight & 0b01111111) | ((id >> 1) & 0b10000000);
+  rom_byte[1] = id & 0xFF;
+
+  return rom_word;
+}
+
 #endif
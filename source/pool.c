@@ -0,0 +1,149 @@
+#include "pool.h"
+
+#ifdef CTM_PARALLEL
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+// Ease off the core while spinning
+static inline void ctm_pool_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+// Worker thread: waits for each call, spinning and then
+// sleeping, and runs it
+static void* ctm_pool_worker(void* arg) {
+  CtmPoolWorker* const w = arg;
+  CtmPool* const p = w->pool;
+
+  uint32_t seen = 0;
+
+  for(;;) {
+    uint32_t gen = __atomic_load_n(&p->_generation, __ATOMIC_ACQUIRE);
+
+    for(uint32_t spins = 0; gen == seen && spins < CTM_POOL_SPIN; spins++) {
+      ctm_pool_pause();
+      gen = __atomic_load_n(&p->_generation, __ATOMIC_ACQUIRE);
+    }
+
+    if(gen == seen) {
+      pthread_mutex_lock(&p->_lock);
+
+      while((gen = __atomic_load_n(&p->_generation, __ATOMIC_ACQUIRE)) == seen) {
+        pthread_cond_wait(&p->_wake, &p->_lock);
+      }
+
+      pthread_mutex_unlock(&p->_lock);
+    }
+
+    seen = gen;
+
+    if(p->_closing) {
+      break;
+    }
+
+    p->_fn(p->_arg, w->id);
+
+    __atomic_sub_fetch(&p->_pending, 1, __ATOMIC_RELEASE);
+  }
+
+  return NULL;
+}
+
+// Start the next call (or the shutdown) on every worker
+static void ctm_pool_signal(CtmPool* const p) {
+  pthread_mutex_lock(&p->_lock);
+  __atomic_add_fetch(&p->_generation, 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&p->_wake);
+  pthread_mutex_unlock(&p->_lock);
+}
+
+// Start a pool of the given number of threads (the calling
+// thread is one of them); returns 0 if the workers can't be
+// started
+uint8_t ctm_pool_init(CtmPool* const p, const uint16_t threads) {
+  memset(p, 0, sizeof(*p));
+
+  p->threads = threads > 0 ? threads : 1;
+
+  pthread_mutex_init(&p->_lock, NULL);
+  pthread_cond_init(&p->_wake, NULL);
+
+  if(p->threads == 1) {
+    return 1;
+  }
+
+  p->_workers = calloc(p->threads - 1, sizeof(CtmPoolWorker));
+
+  if(p->_workers == NULL) {
+    p->threads = 1;
+    ctm_pool_free(p);
+    return 0;
+  }
+
+  for(uint16_t i = 1; i < p->threads; i++) {
+    CtmPoolWorker* const w = &p->_workers[i - 1];
+
+    w->pool = p;
+    w->id = i;
+
+    if(pthread_create(&w->thread, NULL, ctm_pool_worker, w) != 0) {
+      // Only the workers started so far are stopped
+      p->threads = i;
+      ctm_pool_free(p);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+// Stop the workers
+void ctm_pool_free(CtmPool* const p) {
+  if(p->threads > 1) {
+    p->_closing = 1;
+    ctm_pool_signal(p);
+
+    for(uint16_t i = 1; i < p->threads; i++) {
+      pthread_join(p->_workers[i - 1].thread, NULL);
+    }
+  }
+
+  free(p->_workers);
+  p->_workers = NULL;
+  p->threads = 1;
+
+  pthread_mutex_destroy(&p->_lock);
+  pthread_cond_destroy(&p->_wake);
+}
+
+// Call a function on every thread of the pool, and wait
+// for them all
+void ctm_pool_run(CtmPool* const p, CtmPoolFn fn, void* arg) {
+  if(p->threads == 1) {
+    fn(arg, 0);
+    return;
+  }
+
+  p->_fn = fn;
+  p->_arg = arg;
+  __atomic_store_n(&p->_pending, p->threads - 1, __ATOMIC_RELAXED);
+
+  ctm_pool_signal(p);
+
+  fn(arg, 0);
+
+  for(uint32_t spins = 0; __atomic_load_n(&p->_pending, __ATOMIC_ACQUIRE) != 0; spins++) {
+    if(spins < CTM_POOL_SPIN) {
+      ctm_pool_pause();
+    }
+    else {
+      sched_yield();
+    }
+  }
+}
+
+#endif
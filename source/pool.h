@@ -0,0 +1,73 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "defines.h"
+
+#ifdef CTM_PARALLEL
+
+//
+// Fork-join pool of worker threads
+//
+// ctm_pool_run calls a function once on every thread of
+// the pool, the calling thread included, and returns once
+// every call has. Between calls, workers spin for a while
+// before going to sleep, so calls in quick succession (one
+// or more per tick) don't wait on a wakeup.
+//
+
+// Polls of a flag before a waiting thread sleeps (workers)
+// or yields (the calling thread)
+#define CTM_POOL_SPIN 4096
+
+// Function run on each thread, given the argument passed
+// to ctm_pool_run and the thread's index (zero for the
+// calling thread)
+typedef void (*CtmPoolFn)(void*, const uint16_t);
+
+typedef struct {
+  struct CtmPool* pool;
+  uint16_t id;
+  pthread_t thread;
+} CtmPoolWorker;
+
+typedef struct CtmPool {
+  // Number of threads, the calling thread included
+  uint16_t threads;
+
+  // Workers (threads - 1 of them)
+  CtmPoolWorker* _workers;
+
+  // Call under way
+  CtmPoolFn _fn;
+  void* _arg;
+
+  // Number of calls started, and the workers that have yet
+  // to finish the current one
+  uint32_t _generation;
+  uint32_t _pending;
+
+  uint8_t _closing;
+
+  // Sleeping workers wait for the next call on _wake
+  pthread_mutex_t _lock;
+  pthread_cond_t _wake;
+} CtmPool;
+
+// Start a pool of the given number of threads (the calling
+// thread is one of them), which mustn't be moved until it
+// is freed; returns 0 if the workers can't be started
+uint8_t ctm_pool_init(CtmPool* const, const uint16_t);
+
+// Stop the workers
+void ctm_pool_free(CtmPool* const);
+
+// Call a function on every thread of the pool, and wait
+// for them all
+void ctm_pool_run(CtmPool* const, CtmPoolFn, void*);
+
+#endif
+
+#endif
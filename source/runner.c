@@ -0,0 +1,390 @@
+// Core pinning is a GNU extension
+#define _GNU_SOURCE
+
+#include "runner.h"
+
+#ifdef CTM_RUNNER
+
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+
+static uint64_t ctm_runner_clock_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Next number of a splitmix64 sequence
+static uint64_t ctm_runner_random(uint64_t* const state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+
+  z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27))*0x94D049BB133111EBull;
+
+  return z ^ (z >> 31);
+}
+
+// Number of neurons that discharged in the last tick
+static CtmId ctm_runner_discharges(Connectome* const c) {
+  CtmId count = 0;
+
+#ifdef CTM_FRONTIER
+  const CtmId words = CTM_BITSET_WORDS(c->_neurons_tot);
+
+  for(CtmId w = 0; w < words; w++) {
+    count += __builtin_popcountll(c->_discharged[w]);
+  }
+#else
+  for(CtmId id = 0; id < c->_neurons_tot; id++) {
+    count += ctm_get_discharge(c, id);
+  }
+#endif
+
+  return count;
+}
+
+// Run an experiment in a simulation whose state lives in
+// the given block, with stimulus scratch space that grows
+// as needed
+static void ctm_experiment_run_in(const CtmNetwork* const net, const CtmExperiment* const e, CtmExperimentResult* const r, void* block, const size_t block_size, CtmId** const stim, size_t* const stim_len) {
+  const uint64_t begin = ctm_runner_clock_ns();
+
+  r->ok = 0;
+  r->discharges = 0;
+  r->elapsed_ns = 0;
+
+  if(r->readouts != NULL) {
+    memset(r->readouts, 0, e->readouts_len*sizeof(uint64_t));
+  }
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+  // Registered stimuli belong to the simulation they were
+  // registered with, and every experiment runs in one of
+  // its own
+  for(uint32_t p = 0; e->schedule != NULL && p < e->phases; p++) {
+    if(e->schedule[p].cached != 0) {
+      return;
+    }
+  }
+#endif
+
+  Connectome c;
+
+  if(!ctm_init_in_buffer(&c, net, block, block_size)) {
+    return;
+  }
+
+#ifdef CTM_SNAPSHOT
+  if(e->state != NULL && !ctm_load_state(&c, e->state, e->state_size)) {
+    return;
+  }
+#endif
+
+  if(e->params != NULL && !ctm_set_params(&c, e->params)) {
+    return;
+  }
+
+#ifdef CTM_FRONTIER
+  ctm_set_mode(&c, e->mode);
+#endif
+
+  // Longest stimulus the noise is added to
+  CtmId longest = 0;
+
+  for(uint32_t p = 0; e->schedule != NULL && p < e->phases; p++) {
+    if(e->schedule[p].ticks > 0 && e->schedule[p].len > longest) {
+      longest = e->schedule[p].len;
+    }
+  }
+
+  const uint8_t noisy = e->noise > 0 && net->neurons > 0;
+
+  if(noisy && *stim_len < (size_t)longest + e->noise) {
+    CtmId* const grown = realloc(*stim, ((size_t)longest + e->noise)*sizeof(CtmId));
+
+    if(grown == NULL) {
+      return;
+    }
+
+    *stim = grown;
+    *stim_len = (size_t)longest + e->noise;
+  }
+
+  uint64_t rng = e->seed;
+
+  CtmScheduleCursor cursor;
+  ctm_schedule_start(&cursor, e->schedule, e->phases);
+
+  for(uint64_t t = 0; t < e->ticks; t++) {
+    uint64_t one = 1;
+
+    const CtmSchedulePhase* const phase = ctm_schedule_advance(&cursor, &one);
+    const CtmId* ids = phase != NULL ? phase->stimulus : NULL;
+    CtmId len = ids != NULL ? phase->len : 0;
+
+    if(noisy) {
+      CtmId* const buf = *stim;
+
+      if(len > 0) {
+        memcpy(buf, ids, len*sizeof(CtmId));
+      }
+
+      for(CtmId i = 0; i < e->noise; i++) {
+        buf[len + i] = (CtmId)(((ctm_runner_random(&rng) >> 32)*net->neurons) >> 32);
+      }
+
+      ids = buf;
+      len += e->noise;
+    }
+
+    ctm_neural_cycle(&c, ids, len);
+
+    r->discharges += ctm_runner_discharges(&c);
+
+    if(r->readouts != NULL) {
+      for(uint32_t g = 0; g < e->readouts_len; g++) {
+        r->readouts[g] += ctm_group_discharges(&c, &e->readouts[g]);
+      }
+    }
+  }
+
+  r->ok = 1;
+  r->elapsed_ns = ctm_runner_clock_ns() - begin;
+}
+
+// Run one experiment on the calling thread, in a
+// simulation of the given network
+void ctm_experiment_run(const CtmNetwork* const net, const CtmExperiment* const e, CtmExperimentResult* const r) {
+  const size_t size = ctm_required_size(net);
+  void* block;
+
+  r->worker = 0;
+
+  if(posix_memalign(&block, CTM_ALIGN, size) != 0) {
+    r->ok = 0;
+    return;
+  }
+
+  CtmId* stim = NULL;
+  size_t stim_len = 0;
+
+  ctm_experiment_run_in(net, e, r, block, size, &stim, &stim_len);
+
+  free(stim);
+  free(block);
+}
+
+// Set up a runner for the given network with the given
+// number of workers (zero for one per online core),
+// pinning them to cores if pin is set; returns 0 if its
+// buffers can't be allocated
+uint8_t ctm_runner_init(CtmRunner* const r, const CtmNetwork* const net, const uint16_t workers, const uint8_t pin) {
+  memset(r, 0, sizeof(*r));
+
+  r->_network = net;
+  r->pin = pin;
+  r->workers = workers;
+
+  if(r->workers == 0) {
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    r->workers = cores > 0 ? (cores < UINT16_MAX ? (uint16_t)cores : UINT16_MAX) : 1;
+  }
+
+  void* mem;
+
+  if(posix_memalign(&mem, CTM_ALIGN, r->workers*sizeof(CtmRunnerWorker)) != 0) {
+    return 0;
+  }
+
+  r->_workers = mem;
+  memset(r->_workers, 0, r->workers*sizeof(CtmRunnerWorker));
+
+  r->_block_size = ctm_required_size(net);
+
+  for(uint16_t i = 0; i < r->workers; i++) {
+    CtmRunnerWorker* const w = &r->_workers[i];
+
+    w->_id = i;
+    w->_runner = r;
+
+    if(posix_memalign(&w->_block, CTM_ALIGN, r->_block_size) != 0) {
+      w->_block = NULL;
+      ctm_runner_free(r);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+void ctm_runner_free(CtmRunner* const r) {
+  if(r->_workers != NULL) {
+    for(uint16_t i = 0; i < r->workers; i++) {
+      free(r->_workers[i]._block);
+      free(r->_workers[i]._stim);
+    }
+  }
+
+  free(r->_workers);
+  r->_workers = NULL;
+}
+
+// Claim an experiment from the front of a worker's queue
+// (its own end) or from the back (a thief's); returns 0 if
+// the queue is empty
+static uint8_t ctm_runner_claim(CtmRunnerWorker* const w, const uint8_t back, uint32_t* const pos) {
+  uint64_t range = __atomic_load_n(&w->_range, __ATOMIC_ACQUIRE);
+
+  for(;;) {
+    const uint32_t head = (uint32_t)range;
+    const uint32_t tail = (uint32_t)(range >> 32);
+
+    if(head >= tail) {
+      return 0;
+    }
+
+    const uint64_t next = back ?
+      ((uint64_t)(tail - 1) << 32) | head :
+      ((uint64_t)tail << 32) | (head + 1);
+
+    // A failed swap reloads the range
+    if(__atomic_compare_exchange_n(&w->_range, &range, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      *pos = back ? tail - 1 : head;
+      return 1;
+    }
+  }
+}
+
+// Worker thread: runs its own queue from the front, then
+// steals from the back of the others' until every queue
+// is empty
+static void* ctm_runner_worker(void* arg) {
+  CtmRunnerWorker* const w = arg;
+  CtmRunner* const r = w->_runner;
+
+#ifdef __linux__
+  if(r->pin) {
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if(cores > 0) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(w->_id % cores, &set);
+
+      // Running unpinned is no worse than a batch without
+      // pinning
+      pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+  }
+#endif
+
+  uint32_t pos;
+
+  for(;;) {
+    uint8_t claimed = ctm_runner_claim(w, 0, &pos);
+
+    for(uint16_t i = 1; !claimed && i < r->workers; i++) {
+      claimed = ctm_runner_claim(&r->_workers[(w->_id + i) % r->workers], 1, &pos);
+    }
+
+    if(!claimed) {
+      break;
+    }
+
+    const uint32_t index = r->_order[pos];
+    CtmExperimentResult* const result = &r->_results[index];
+
+    ctm_experiment_run_in(r->_network, &r->_experiments[index], result, w->_block, r->_block_size, &w->_stim, &w->_stim_len);
+    result->worker = w->_id;
+  }
+
+  return NULL;
+}
+
+typedef struct {
+  uint64_t ticks;
+  uint32_t index;
+} CtmRunnerJob;
+
+// Longest first, then in batch order
+static int ctm_runner_compare_jobs(const void* a, const void* b) {
+  const CtmRunnerJob* x = a;
+  const CtmRunnerJob* y = b;
+
+  if(x->ticks != y->ticks) {
+    return (x->ticks < y->ticks) - (x->ticks > y->ticks);
+  }
+
+  return (x->index > y->index) - (x->index < y->index);
+}
+
+// Run a batch of experiments, filling in one result for
+// each, and wait for them all; returns 0 if no worker can
+// be started
+uint8_t ctm_runner_run(CtmRunner* const r, const CtmExperiment* experiments, CtmExperimentResult* results, const uint32_t len) {
+  if(len == 0) {
+    return 1;
+  }
+
+  CtmRunnerJob* jobs = malloc(len*sizeof(CtmRunnerJob));
+  uint32_t* order = malloc(len*sizeof(uint32_t));
+
+  if(jobs == NULL || order == NULL) {
+    free(jobs);
+    free(order);
+    return 0;
+  }
+
+  for(uint32_t i = 0; i < len; i++) {
+    jobs[i].ticks = experiments[i].ticks;
+    jobs[i].index = i;
+  }
+
+  qsort(jobs, len, sizeof(CtmRunnerJob), ctm_runner_compare_jobs);
+
+  // Experiments are dealt out round-robin, longest first,
+  // and each worker's share is stored contiguously in
+  // _order
+  const uint16_t workers = len < r->workers ? (uint16_t)len : r->workers;
+  uint32_t start = 0;
+
+  for(uint16_t i = 0; i < r->workers; i++) {
+    const uint32_t share = i < workers ? (len - i + workers - 1)/workers : 0;
+
+    for(uint32_t k = 0; k < share; k++) {
+      order[start + k] = jobs[i + k*workers].index;
+    }
+
+    r->_workers[i]._range = ((uint64_t)(start + share) << 32) | start;
+    start += share;
+  }
+
+  free(jobs);
+
+  r->_experiments = experiments;
+  r->_results = results;
+  r->_order = order;
+
+  uint16_t started = 0;
+
+  for(; started < workers; started++) {
+    if(pthread_create(&r->_workers[started]._thread, NULL, ctm_runner_worker, &r->_workers[started]) != 0) {
+      break;
+    }
+  }
+
+  // Experiments queued for workers that didn't start are
+  // stolen by the others
+  for(uint16_t i = 0; i < started; i++) {
+    pthread_join(r->_workers[i]._thread, NULL);
+  }
+
+  free(order);
+  r->_order = NULL;
+
+  return started > 0;
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "defines.h"
+#include "network.h"
+#include "connectome.h"
+#include "group.h"
+
+#ifdef CTM_RUNNER
+
+//
+// Parallel runner for batches of experiments
+//
+// An experiment is one simulation of a shared network: a
+// stimulus schedule, parameters and mode, a number of
+// ticks, and groups of cells whose discharges are counted.
+// A batch is spread over a pool of worker threads (pinned
+// to cores where the platform allows it), each with a
+// queue of experiments; workers whose queue runs dry steal
+// from the back of the others', so uneven run lengths
+// don't leave cores idle. Experiments are queued longest
+// first.
+//
+// The network is only read, and every experiment's result
+// is written by the one worker that ran it, so nothing is
+// locked while a batch runs. Results are the same whatever
+// the number of workers, and whichever worker runs each
+// experiment.
+//
+
+typedef struct {
+  // Stimulus schedule (see ctm_run), which starts over
+  // once it runs out (NULL for no stimulus); its phases
+  // can't use registered stimuli, since every experiment
+  // runs in a simulation of its own
+  const CtmSchedulePhase* schedule;
+  uint32_t phases;
+
+  // Ticks to run
+  uint64_t ticks;
+
+  // Simulation parameters (NULL for the compiled-in ones,
+  // or the snapshot's) and mode (see ctm_set_mode)
+  const CtmParams* params;
+  uint8_t mode;
+
+#ifdef CTM_SNAPSHOT
+  // Snapshot to start from (NULL to start at rest; see
+  // ctm_save_state)
+  const void* state;
+  size_t state_size;
+#endif
+
+  // Number of neurons picked at random and pinged every
+  // tick on top of the schedule's, and the seed they are
+  // picked with
+  CtmId noise;
+  uint64_t seed;
+
+  // Groups whose discharges are counted (compiled for the
+  // runner's network)
+  const CtmGroup* readouts;
+  uint32_t readouts_len;
+} CtmExperiment;
+
+typedef struct {
+  // Discharges of each readout group summed over every
+  // tick, readouts_len entries (set by the caller before
+  // the run; NULL if not wanted)
+  uint64_t* readouts;
+
+  // Whether the experiment ran (its parameters or
+  // snapshot may be invalid, or its schedule may use
+  // registered stimuli)
+  uint8_t ok;
+
+  // Discharges of every neuron, summed over every tick
+  uint64_t discharges;
+
+  // Worker that ran the experiment, and the time it took
+  // in nanoseconds
+  uint16_t worker;
+  uint64_t elapsed_ns;
+} CtmExperimentResult;
+
+// Worker, padded to a cache line of its own
+//
+// Its queue holds experiments _order[head] through
+// _order[tail - 1], with head in the low 32 bits of
+// _range and tail in the high ones, so that the worker and
+// a thief can both claim them with a compare-and-swap
+typedef struct {
+  uint64_t _range;
+
+  // Simulation state block, reused by every experiment
+  void* _block;
+
+  // Stimulus scratch space, and its length
+  CtmId* _stim;
+  size_t _stim_len;
+
+  pthread_t _thread;
+  uint16_t _id;
+  struct CtmRunner* _runner;
+} __attribute__((aligned(CTM_ALIGN))) CtmRunnerWorker;
+
+typedef struct CtmRunner {
+  const CtmNetwork* _network;
+
+  // Number of worker threads, and whether they are pinned
+  // to cores
+  uint16_t workers;
+  uint8_t pin;
+
+  CtmRunnerWorker* _workers;
+
+  // Size of each worker's state block
+  size_t _block_size;
+
+  //
+  // Batch under way
+  //
+
+  const CtmExperiment* _experiments;
+  CtmExperimentResult* _results;
+  uint32_t* _order;
+} CtmRunner;
+
+// Set up a runner for the given network (which must
+// outlive it) with the given number of workers (zero for
+// one per online core), pinning them to cores if pin is
+// set; returns 0 if its buffers can't be allocated
+uint8_t ctm_runner_init(CtmRunner* const, const CtmNetwork* const, const uint16_t, const uint8_t);
+
+void ctm_runner_free(CtmRunner* const);
+
+// Run a batch of experiments, filling in one result for
+// each, and wait for them all; returns 0 if no worker can
+// be started
+uint8_t ctm_runner_run(CtmRunner* const, const CtmExperiment*, CtmExperimentResult*, const uint32_t);
+
+// Run one experiment on the calling thread, in a
+// simulation of the given network
+void ctm_experiment_run(const CtmNetwork* const, const CtmExperiment* const, CtmExperimentResult* const);
+
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+#include "synapse_table.h"
+
+#ifdef CTM_SYNAPSE_TABLE
+
+// Expand ROM words (laid out as in NEURAL_ROM) into a
+// synapse table; returns 0 if memory runs out
+uint8_t ctm_synapse_table_init(CtmSynapseTable* const t, const uint16_t* rom) {
+  // Word 0 gives the number of rows, words 1 through rows + 1
+  // give the address of each row within the ROM
+  const CtmId rows = READ_WORD(rom, 0);
+  const uint16_t base = READ_WORD(rom, 1);
+
+  t->rows = rows;
+  t->len = READ_WORD(rom, rows + 1) - base;
+
+  t->row_offset = malloc((rows + 1)*sizeof(uint32_t));
+  t->target = malloc(((size_t)t->len + 1)*sizeof(CtmId));
+  t->weight = malloc(((size_t)t->len + 1)*sizeof(CtmWeight));
+
+  if(t->row_offset == NULL || t->target == NULL || t->weight == NULL) {
+    ctm_synapse_table_free(t);
+    return 0;
+  }
+
+  // Rebase row addresses so that they index the
+  // target and weight arrays
+  for(CtmId i = 0; i <= rows; i++) {
+    t->row_offset[i] = READ_WORD(rom, i + 1) - base;
+  }
+
+  for(uint32_t i = 0; i < t->len; i++) {
+    NeuronConnection neuron_conn = parse_rom_word(READ_WORD(rom, base + i));
+
+    t->target[i] = neuron_conn.id;
+    t->weight[i] = neuron_conn.weight;
+  }
+
+  return 1;
+}
+
+#ifdef CTM_WIDE_NETWORKS
+// Decode connections in the wide encoding (see wide_rom.h)
+// into a synapse table, given the run index and data, their
+// size, the number of rows, cells and connections; returns 0
+// if the data are malformed or memory runs out
+uint8_t ctm_synapse_table_init_wide(CtmSynapseTable* const t, const uint32_t* index, const uint8_t* data, const uint32_t size, const CtmId rows, const CtmId cells, const uint32_t len) {
+  t->rows = rows;
+  t->len = len;
+
+  t->row_offset = malloc(((size_t)rows + 1)*sizeof(uint32_t));
+  t->target = malloc(((size_t)len + 1)*sizeof(CtmId));
+  t->weight = malloc(((size_t)len + 1)*sizeof(CtmWeight));
+
+  if(t->row_offset == NULL || t->target == NULL || t->weight == NULL ||
+      !ctm_wide_decode(index, data, size, rows, cells, len, t->row_offset, t->target, t->weight)) {
+    ctm_synapse_table_free(t);
+    return 0;
+  }
+
+  return 1;
+}
+#endif
+
+// Build the reverse index of a synapse table covering
+// the given number of cells; returns 0 if memory runs out
+uint8_t ctm_reverse_table_init(CtmReverseTable* const r, const CtmSynapseTable* const t, const CtmId cells) {
+  r->cols = cells;
+  r->len = t->len;
+
+  r->col_offset = calloc((size_t)cells + 1, sizeof(uint32_t));
+  r->source = malloc(((size_t)t->len + 1)*sizeof(CtmId));
+  r->weight = malloc(((size_t)t->len + 1)*sizeof(CtmWeight));
+
+  // Scratch space for filling in columns
+  uint32_t* fill = malloc(((size_t)cells + 1)*sizeof(uint32_t));
+
+  if(r->col_offset == NULL || r->source == NULL || r->weight == NULL || fill == NULL) {
+    free(fill);
+    ctm_reverse_table_free(r);
+    return 0;
+  }
+
+  // Count incoming connections, then turn the counts
+  // into offsets
+  for(uint32_t i = 0; i < t->len; i++) {
+    r->col_offset[t->target[i] + 1]++;
+  }
+
+  for(CtmId i = 0; i < cells; i++) {
+    r->col_offset[i + 1] += r->col_offset[i];
+  }
+
+  // Rows are visited in source order, so each column
+  // ends up sorted by source
+  memcpy(fill, r->col_offset, cells*sizeof(uint32_t));
+
+  for(CtmId src = 0; src < t->rows; src++) {
+    for(uint32_t i = t->row_offset[src]; i < t->row_offset[src + 1]; i++) {
+      const uint32_t pos = fill[t->target[i]]++;
+
+      r->source[pos] = src;
+      r->weight[pos] = t->weight[i];
+    }
+  }
+
+  free(fill);
+
+  return 1;
+}
+
+void ctm_synapse_table_free(CtmSynapseTable* const t) {
+  free(t->row_offset);
+  free(t->target);
+  free(t->weight);
+
+  t->row_offset = NULL;
+  t->target = NULL;
+  t->weight = NULL;
+}
+
+void ctm_reverse_table_free(CtmReverseTable* const r) {
+  free(r->col_offset);
+  free(r->source);
+  free(r->weight);
+
+  r->col_offset = NULL;
+  r->source = NULL;
+  r->weight = NULL;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef SYNAPSE_TABLE_H
+#define SYNAPSE_TABLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "neural_rom.h"
+#include "wide_rom.h"
+
+//
+// Pre-decoded copy of a connectome's ROM words (see
+// NEURAL_ROM) in compressed-sparse-row form
+//
+// The connections of neuron i are found at positions
+// row_offset[i] through row_offset[i + 1] - 1 of the
+// target and weight arrays, in the same order as in the ROM
+//
+
+typedef struct {
+  // Number of neurons with outgoing connections
+  CtmId rows;
+
+  // Total number of connections
+  uint32_t len;
+
+  // Start of each neuron's connections (rows + 1 entries)
+  uint32_t* row_offset;
+
+  // Connection targets and weights (len entries each)
+  CtmId* target;
+  CtmWeight* weight;
+
+} CtmSynapseTable;
+
+//
+// Transposed copy of a synapse table, listing the incoming
+// connections of every cell
+//
+// The connections into cell i are found at positions
+// col_offset[i] through col_offset[i + 1] - 1 of the
+// source and weight arrays, sorted by source id (i.e. in
+// the order a full discharge pass would apply them)
+//
+
+typedef struct {
+  // Number of cells (neurons and muscles)
+  CtmId cols;
+
+  // Total number of connections
+  uint32_t len;
+
+  // Start of each cell's connections (cols + 1 entries)
+  uint32_t* col_offset;
+
+  // Connection sources and weights (len entries each)
+  CtmId* source;
+  CtmWeight* weight;
+
+} CtmReverseTable;
+
+// Expand ROM words (laid out as in NEURAL_ROM) into a
+// synapse table; returns 0 if memory runs out
+uint8_t ctm_synapse_table_init(CtmSynapseTable* const, const uint16_t*);
+
+#ifdef CTM_WIDE_NETWORKS
+// Decode connections in the wide encoding (see wide_rom.h)
+// into a synapse table, given the run index and data, their
+// size, the number of rows, cells and connections; returns 0
+// if the data are malformed or memory runs out
+uint8_t ctm_synapse_table_init_wide(CtmSynapseTable* const, const uint32_t*, const uint8_t*, const uint32_t, const CtmId, const CtmId, const uint32_t);
+#endif
+
+// Build the reverse index of a synapse table covering
+// the given number of cells; returns 0 if memory runs out
+uint8_t ctm_reverse_table_init(CtmReverseTable* const, const CtmSynapseTable* const, const CtmId);
+
+// Release the arrays of either kind of table (which may
+// be released again)
+void ctm_synapse_table_free(CtmSynapseTable* const);
+void ctm_reverse_table_free(CtmReverseTable* const);
+
+#endif
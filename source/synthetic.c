@@ -0,0 +1,562 @@
+#include "synthetic.h"
+
+#if defined(CTM_SYNAPSE_TABLE) && defined(CTM_WIDE_NETWORKS)
+
+// Probabilities are turned into integer weights out of
+// 2^52, so that sampling takes integer arithmetic alone
+#define CTM_SYNTHETIC_ONE ((uint64_t)1 << 52)
+
+//
+// Random numbers
+//
+
+// Next number of a splitmix64 sequence
+static uint64_t ctm_synthetic_random(uint64_t* const state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+
+  z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27))*0x94D049BB133111EBull;
+
+  return z ^ (z >> 31);
+}
+
+// Uniform number below n (which mustn't be zero)
+static uint64_t ctm_synthetic_below(uint64_t* const state, const uint64_t n) {
+  return (uint64_t)(((unsigned __int128)ctm_synthetic_random(state)*n) >> 64);
+}
+
+//
+// Discrete distributions over 0 through len - 1, held as
+// cumulative integer weights
+//
+
+typedef struct {
+  uint64_t* cum;
+  uint32_t len;
+} CtmDist;
+
+// Turn an array of len counts into a distribution in place
+// (a distribution of nothing but fallback if they are all
+// zero); takes over the array
+static void ctm_dist_from_counts(CtmDist* const d, uint64_t* counts, const uint32_t len, const uint32_t fallback) {
+  uint64_t total = 0;
+
+  for(uint32_t i = 0; i < len; i++) {
+    total += counts[i];
+    counts[i] = total;
+  }
+
+  d->cum = counts;
+  d->len = len;
+
+  if(total == 0) {
+    for(uint32_t i = fallback; i < len; i++) {
+      counts[i] = 1;
+    }
+  }
+}
+
+// Turn an array of len probabilities (which needn't sum to
+// one) into a distribution; returns 0 if memory runs out
+static uint8_t ctm_dist_from_doubles(CtmDist* const d, const double* p, const uint32_t len) {
+  uint64_t* counts = malloc(len*sizeof(uint64_t));
+
+  if(counts == NULL) {
+    return 0;
+  }
+
+  double sum = 0;
+
+  for(uint32_t i = 0; i < len; i++) {
+    sum += p[i];
+  }
+
+  for(uint32_t i = 0; i < len; i++) {
+    counts[i] = sum > 0 ? (uint64_t)(p[i]/sum*CTM_SYNTHETIC_ONE) : 0;
+  }
+
+  ctm_dist_from_counts(d, counts, len, 0);
+
+  return 1;
+}
+
+static uint32_t ctm_dist_sample(const CtmDist* const d, uint64_t* const state) {
+  const uint64_t r = ctm_synthetic_below(state, d->cum[d->len - 1]);
+
+  // First value whose cumulative weight is past r
+  uint32_t lo = 0;
+  uint32_t hi = d->len - 1;
+
+  while(lo < hi) {
+    const uint32_t mid = lo + (hi - lo)/2;
+
+    if(d->cum[mid] > r) {
+      hi = mid;
+    }
+    else {
+      lo = mid + 1;
+    }
+  }
+
+  return lo;
+}
+
+// Poisson distribution, worked out from its mode outwards
+// so that no term overflows
+static uint8_t ctm_dist_poisson(CtmDist* const d, const double mean) {
+  const uint32_t mode = (uint32_t)mean;
+  uint32_t len = mode + 16;
+
+  // Past ten standard deviations, terms are negligible
+  while((double)(len - mode)*(len - mode) < 100*mean) {
+    len += 16;
+  }
+
+  double* p = malloc(len*sizeof(double));
+
+  if(p == NULL) {
+    return 0;
+  }
+
+  p[mode] = 1;
+
+  for(uint32_t k = mode; k > 0; k--) {
+    p[k - 1] = p[k]*k/mean;
+  }
+
+  for(uint32_t k = mode + 1; k < len; k++) {
+    p[k] = p[k - 1]*mean/k;
+  }
+
+  const uint8_t ok = ctm_dist_from_doubles(d, p, len);
+
+  free(p);
+
+  return ok;
+}
+
+// Power law over 1 through max
+static uint8_t ctm_dist_power_law(CtmDist* const d, const double exponent, const uint32_t max) {
+  double* p = malloc(((size_t)max + 1)*sizeof(double));
+
+  if(p == NULL) {
+    return 0;
+  }
+
+  p[0] = 0;
+
+  for(uint32_t k = 1; k <= max; k++) {
+    p[k] = pow(k, -exponent);
+  }
+
+  const uint8_t ok = ctm_dist_from_doubles(d, p, max + 1);
+
+  free(p);
+
+  return ok;
+}
+
+//
+// Statistics of a model network
+//
+
+typedef struct {
+  // Neuron to neuron out-degrees and weight magnitudes
+  CtmDist degree;
+  CtmDist weight;
+
+  // Muscle out-degrees of neurons that have any, and
+  // their weight magnitudes
+  CtmDist muscle_degree;
+  CtmDist muscle_weight;
+
+  // Numbers of neurons, of neurons with muscle outputs
+  // and of neurons with negative weights, and number of
+  // muscles
+  CtmId neurons;
+  CtmId motor;
+  CtmId inhibitory;
+  CtmId muscles;
+
+  // Mean and largest neuron to neuron out-degree
+  double mean_degree;
+  uint32_t max_degree;
+} CtmModel;
+
+static void ctm_model_free(CtmModel* const m) {
+  free(m->degree.cum);
+  free(m->weight.cum);
+  free(m->muscle_degree.cum);
+  free(m->muscle_weight.cum);
+}
+
+// Gather a model network's statistics; returns 0 if
+// memory runs out
+static uint8_t ctm_model_init(CtmModel* const m, const CtmNetwork* const net) {
+  const CtmSynapseTable* const t = &net->_synapses;
+
+  memset(m, 0, sizeof(*m));
+
+  m->neurons = t->rows;
+  m->muscles = net->cells - t->rows;
+
+  // Sizes of the histograms
+  uint32_t max_degree = 0;
+  uint32_t max_muscle_degree = 0;
+  uint32_t max_weight = 0;
+  uint32_t max_muscle_weight = 0;
+  uint64_t total_degree = 0;
+
+  for(CtmId row = 0; row < t->rows; row++) {
+    uint32_t degree = 0;
+    uint32_t muscle_degree = 0;
+    uint8_t negative = 0;
+
+    for(uint32_t i = t->row_offset[row]; i < t->row_offset[row + 1]; i++) {
+      const uint32_t w = t->weight[i] < 0 ? -(int32_t)t->weight[i] : t->weight[i];
+
+      negative |= t->weight[i] < 0;
+
+      if(t->target[i] < t->rows) {
+        degree++;
+        max_weight = w > max_weight ? w : max_weight;
+      }
+      else {
+        muscle_degree++;
+        max_muscle_weight = w > max_muscle_weight ? w : max_muscle_weight;
+      }
+    }
+
+    max_degree = degree > max_degree ? degree : max_degree;
+    max_muscle_degree = muscle_degree > max_muscle_degree ? muscle_degree : max_muscle_degree;
+    total_degree += degree;
+
+    m->motor += muscle_degree > 0;
+    m->inhibitory += negative;
+  }
+
+  m->max_degree = max_degree;
+  m->mean_degree = t->rows > 0 ? (double)total_degree/t->rows : 0;
+
+  // Weights of at least one, and a muscle degree of one,
+  // stand in for anything the model lacks
+  uint64_t* degree = calloc((size_t)max_degree + 1, sizeof(uint64_t));
+  uint64_t* weight = calloc((size_t)max_weight + 2, sizeof(uint64_t));
+  uint64_t* muscle_degree = calloc((size_t)max_muscle_degree + 2, sizeof(uint64_t));
+  uint64_t* muscle_weight = calloc((size_t)max_muscle_weight + 2, sizeof(uint64_t));
+
+  if(degree == NULL || weight == NULL || muscle_degree == NULL || muscle_weight == NULL) {
+    free(degree);
+    free(weight);
+    free(muscle_degree);
+    free(muscle_weight);
+    return 0;
+  }
+
+  for(CtmId row = 0; row < t->rows; row++) {
+    uint32_t d = 0;
+    uint32_t md = 0;
+
+    for(uint32_t i = t->row_offset[row]; i < t->row_offset[row + 1]; i++) {
+      const uint32_t w = t->weight[i] < 0 ? -(int32_t)t->weight[i] : t->weight[i];
+
+      if(t->target[i] < t->rows) {
+        d++;
+        weight[w]++;
+      }
+      else {
+        md++;
+        muscle_weight[w]++;
+      }
+    }
+
+    degree[d]++;
+
+    if(md > 0) {
+      muscle_degree[md]++;
+    }
+  }
+
+  ctm_dist_from_counts(&m->degree, degree, max_degree + 1, 0);
+  ctm_dist_from_counts(&m->weight, weight, max_weight + 2, 1);
+  ctm_dist_from_counts(&m->muscle_degree, muscle_degree, max_muscle_degree + 2, 1);
+  ctm_dist_from_counts(&m->muscle_weight, muscle_weight, max_muscle_weight + 2, 1);
+
+  return 1;
+}
+
+// Statistics of the given model network, or of the
+// compiled-in one
+static uint8_t ctm_model_of(CtmModel* const m, const CtmNetwork* const net) {
+  if(net != NULL) {
+    return ctm_model_init(m, net);
+  }
+
+  CtmNetwork builtin;
+
+  if(!ctm_network_builtin(&builtin)) {
+    return 0;
+  }
+
+  const uint8_t ok = ctm_model_init(m, &builtin);
+
+  ctm_network_close(&builtin);
+
+  return ok;
+}
+
+// Fill in parameters for a network of the given number of
+// neurons with the model network's proportions and degree
+// distribution
+void ctm_synthetic_default_params(CtmSyntheticParams* const p, const CtmNetwork* const model, const CtmId neurons) {
+  memset(p, 0, sizeof(*p));
+
+  p->model = model;
+  p->seed = 1;
+  p->neurons = neurons;
+  p->degree = CTM_DEGREE_MODEL;
+
+  CtmModel m;
+
+  if(!ctm_model_of(&m, model) || m.neurons == 0) {
+    return;
+  }
+
+  p->motor = (CtmId)((uint64_t)neurons*m.motor/m.neurons);
+  p->muscles = (CtmId)((uint64_t)neurons*m.muscles/m.neurons);
+  p->inhibitory = (double)m.inhibitory/m.neurons;
+
+  p->mean_degree = m.mean_degree;
+  p->exponent = 2;
+  p->max_degree = m.max_degree;
+
+  ctm_model_free(&m);
+}
+
+//
+// Generation
+//
+
+static int ctm_synthetic_compare(const void* a, const void* b) {
+  const CtmId x = *(const CtmId*)a;
+  const CtmId y = *(const CtmId*)b;
+
+  return (x > y) - (x < y);
+}
+
+// Sort ids and drop repeats; returns how many are left
+static uint32_t ctm_synthetic_unique(CtmId* const ids, const uint32_t len) {
+  if(len == 0) {
+    return 0;
+  }
+
+  qsort(ids, len, sizeof(CtmId), ctm_synthetic_compare);
+
+  uint32_t n = 1;
+
+  for(uint32_t i = 1; i < len; i++) {
+    if(ids[i] != ids[n - 1]) {
+      ids[n++] = ids[i];
+    }
+  }
+
+  return n;
+}
+
+// Table under construction, grown as needed
+typedef struct {
+  CtmSynapseTable* t;
+  uint32_t cap;
+  uint8_t failed;
+} CtmSyntheticBuilder;
+
+static void ctm_synthetic_add(CtmSyntheticBuilder* const b, const CtmId target, const CtmWeight weight) {
+  CtmSynapseTable* const t = b->t;
+
+  if(t->len == b->cap) {
+    const uint32_t cap = b->cap ? 2*b->cap : 4096;
+
+    CtmId* target_grown = realloc(t->target, (size_t)cap*sizeof(CtmId));
+
+    if(target_grown != NULL) {
+      t->target = target_grown;
+    }
+
+    CtmWeight* weight_grown = realloc(t->weight, (size_t)cap*sizeof(CtmWeight));
+
+    if(weight_grown != NULL) {
+      t->weight = weight_grown;
+    }
+
+    if(target_grown == NULL || weight_grown == NULL || cap < b->cap) {
+      b->failed = 1;
+      return;
+    }
+
+    b->cap = cap;
+  }
+
+  t->target[t->len] = target;
+  t->weight[t->len] = weight;
+  t->len++;
+}
+
+// Generate the connections of a synthetic network into a
+// synapse table; returns 0 if the parameters are invalid
+// or memory runs out
+uint8_t ctm_synthetic_table(CtmSynapseTable* const t, const CtmSyntheticParams* const p) {
+  memset(t, 0, sizeof(*t));
+
+  if(p->neurons == 0 || p->motor > p->neurons || (uint64_t)p->neurons + p->muscles > (CtmId)-1) {
+    return 0;
+  }
+
+  if(!(p->inhibitory >= 0 && p->inhibitory <= 1 && p->locality >= 0 && p->locality <= 1)) {
+    return 0;
+  }
+
+  if((p->degree == CTM_DEGREE_POISSON && !(p->mean_degree >= 0 && p->mean_degree < 1e6)) ||
+      (p->degree == CTM_DEGREE_POWER_LAW && (p->max_degree == 0 || !(p->exponent >= 0))) ||
+      p->degree > CTM_DEGREE_POWER_LAW) {
+    return 0;
+  }
+
+  CtmModel m;
+
+  if(!ctm_model_of(&m, p->model)) {
+    return 0;
+  }
+
+  CtmDist poisson = { NULL, 0 };
+  const CtmDist* degree = &m.degree;
+
+  if(p->degree == CTM_DEGREE_POISSON || p->degree == CTM_DEGREE_POWER_LAW) {
+    const uint8_t ok = p->degree == CTM_DEGREE_POISSON ?
+      ctm_dist_poisson(&poisson, p->mean_degree) :
+      ctm_dist_power_law(&poisson, p->exponent, p->max_degree);
+
+    if(!ok) {
+      ctm_model_free(&m);
+      return 0;
+    }
+
+    degree = &poisson;
+  }
+
+  const CtmId n = p->neurons;
+  const CtmId first_motor = n - p->motor;
+
+  // Longest row of either kind
+  const uint32_t longest = degree->len > m.muscle_degree.len ? degree->len : m.muscle_degree.len;
+
+  CtmId* row = malloc(((size_t)longest + 1)*sizeof(CtmId));
+  t->row_offset = malloc(((size_t)n + 1)*sizeof(uint32_t));
+
+  CtmSyntheticBuilder b = { t, 0, row == NULL || t->row_offset == NULL };
+
+  const uint64_t inhibitory = (uint64_t)(p->inhibitory*CTM_SYNTHETIC_ONE);
+  const uint64_t local = (uint64_t)(p->locality*CTM_SYNTHETIC_ONE);
+  const CtmId span = p->span < n ? p->span : n;
+
+  uint64_t rng = p->seed;
+
+  t->rows = n;
+
+  for(CtmId i = 0; i < n && !b.failed; i++) {
+    t->row_offset[i] = t->len;
+
+    const int8_t sign = ctm_synthetic_below(&rng, CTM_SYNTHETIC_ONE) < inhibitory ? -1 : 1;
+
+    // Neuron targets, other than the neuron itself; any
+    // repeats are replaced by targets picked uniformly
+    uint32_t k = ctm_dist_sample(degree, &rng);
+    k = k < n - 1 ? k : n - 1;
+
+    uint32_t picked = 0;
+    uint8_t first_round = 1;
+
+    while(picked < k) {
+      while(picked < k) {
+        CtmId target;
+
+        if(first_round && span > 0 && ctm_synthetic_below(&rng, CTM_SYNTHETIC_ONE) < local) {
+          const uint64_t offset = ctm_synthetic_below(&rng, 2*(uint64_t)span) + 1;
+          const uint64_t at = (uint64_t)i + (offset <= span ? offset : (uint64_t)n - (offset - span));
+
+          target = (CtmId)(at % n);
+        }
+        else {
+          target = (CtmId)ctm_synthetic_below(&rng, n - 1);
+          target += target >= i;
+        }
+
+        if(target != i) {
+          row[picked++] = target;
+        }
+      }
+
+      picked = ctm_synthetic_unique(row, picked);
+      first_round = 0;
+    }
+
+    for(uint32_t j = 0; j < picked; j++) {
+      ctm_synthetic_add(&b, row[j], (CtmWeight)(sign*(int32_t)ctm_dist_sample(&m.weight, &rng)));
+    }
+
+    // Motor neurons drive the muscles around their place
+    // among the motor neurons
+    if(i >= first_motor && p->muscles > 0) {
+      uint32_t mk = ctm_dist_sample(&m.muscle_degree, &rng);
+      mk = mk < p->muscles ? mk : p->muscles;
+
+      const uint64_t share = (p->muscles + p->motor - 1)/p->motor;
+      uint64_t width = 2*share > 2*(uint64_t)mk ? 2*share : 2*(uint64_t)mk;
+      width = width < p->muscles ? width : p->muscles;
+
+      const uint64_t center = (uint64_t)(i - first_motor)*p->muscles/p->motor;
+      uint64_t start = center > width/2 ? center - width/2 : 0;
+      start = start + width <= p->muscles ? start : p->muscles - width;
+
+      picked = 0;
+
+      while(picked < mk) {
+        while(picked < mk) {
+          row[picked++] = (CtmId)(start + ctm_synthetic_below(&rng, width));
+        }
+
+        picked = ctm_synthetic_unique(row, picked);
+      }
+
+      for(uint32_t j = 0; j < picked; j++) {
+        ctm_synthetic_add(&b, n + row[j], (CtmWeight)(sign*(int32_t)ctm_dist_sample(&m.muscle_weight, &rng)));
+      }
+    }
+  }
+
+  free(row);
+  free(poisson.cum);
+  ctm_model_free(&m);
+
+  if(b.failed) {
+    ctm_synapse_table_free(t);
+    return 0;
+  }
+
+  t->row_offset[n] = t->len;
+
+  return 1;
+}
+
+// Set up a handle to a synthetic network (without cell
+// names); returns 0 as ctm_synthetic_table does
+uint8_t ctm_network_synthetic(CtmNetwork* const net, const CtmSyntheticParams* const p) {
+  CtmSynapseTable t;
+
+  if(!ctm_synthetic_table(&t, p)) {
+    return 0;
+  }
+
+  return ctm_network_from_table(net, &t, p->neurons + p->muscles, NULL, 0);
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "defines.h"
+#include "neural_rom.h"
+#include "synapse_table.h"
+#include "network.h"
+
+#if defined(CTM_SYNAPSE_TABLE) && defined(CTM_WIDE_NETWORKS)
+
+//
+// Synthetic connectomes of any size
+//
+// Cells are laid out in layers: neurons first, the last of
+// which are motor neurons, followed by muscles. Every
+// neuron connects to a number of other neurons drawn from
+// a degree distribution, with targets picked uniformly
+// (or, for a share of them, from the neurons with nearby
+// ids); motor neurons also connect to nearby muscles, in
+// proportion to their place among the motor neurons.
+// Weight magnitudes, the number of muscles each motor
+// neuron drives and (by default) neuron out-degrees are
+// resampled from a model network, the compiled-in one
+// unless told otherwise. Each neuron is either excitatory
+// or inhibitory, with weights of one sign only.
+//
+// Generation is deterministic: the same parameters and
+// seed give the same network.
+//
+
+// Degree distributions
+
+// Out-degrees resampled from the model network
+#define CTM_DEGREE_MODEL 0
+
+// Poisson, around mean_degree
+#define CTM_DEGREE_POISSON 1
+
+// Power law, with P(k) proportional to k^-exponent for k
+// from 1 to max_degree
+#define CTM_DEGREE_POWER_LAW 2
+
+typedef struct {
+  // Network that distributions are resampled from (NULL
+  // for the compiled-in one)
+  const CtmNetwork* model;
+
+  uint64_t seed;
+
+  // Number of neurons, how many of them (the last ones)
+  // are motor neurons, and number of muscles
+  CtmId neurons;
+  CtmId motor;
+  CtmId muscles;
+
+  // Distribution of neuron to neuron out-degrees
+  // (CTM_DEGREE_*) and its parameters
+  uint8_t degree;
+  double mean_degree;
+  double exponent;
+  uint32_t max_degree;
+
+  // Share of neurons that are inhibitory
+  double inhibitory;
+
+  // Share of neuron to neuron connections whose target is
+  // picked from the neurons within span ids of the origin
+  double locality;
+  CtmId span;
+} CtmSyntheticParams;
+
+// Fill in parameters for a network of the given number of
+// neurons with the model network's proportions of motor
+// neurons, muscles and inhibitory neurons, and its
+// degree distribution (NULL for the compiled-in network)
+void ctm_synthetic_default_params(CtmSyntheticParams* const, const CtmNetwork* const, const CtmId);
+
+// Generate the connections of a synthetic network into a
+// synapse table (covering neurons + muscles cells); returns
+// 0 if the parameters are invalid or memory runs out
+uint8_t ctm_synthetic_table(CtmSynapseTable* const, const CtmSyntheticParams* const);
+
+// Set up a handle to a synthetic network (without cell
+// names); returns 0 as ctm_synthetic_table does
+uint8_t ctm_network_synthetic(CtmNetwork* const, const CtmSyntheticParams* const);
+
+#endif
+
+#endif
@@ -0,0 +1,502 @@
+#include "trace.h"
+
+#ifdef CTM_TRACE
+
+// Longest varint of a 32-bit value
+#define CTM_VARINT_MAX_BYTES 5
+
+static uint8_t ctm_put_varint(uint8_t* out, uint32_t v) {
+  uint8_t n = 0;
+
+  while(v >= 0x80) {
+    out[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  out[n++] = (uint8_t)v;
+
+  return n;
+}
+
+//
+// Writer
+//
+
+// Encode one tick's bits and write them out
+static void ctm_trace_write_tick(CtmTraceWriter* const w, const CtmBitWord* bits) {
+  // Keyframes are coded against an all-clear tick
+  if(w->_ticks % w->interval == 0) {
+    // Index capacity doubles whenever it is filled
+    if((w->_index_len & (w->_index_len - 1)) == 0) {
+      uint64_t* const index = realloc(w->_index, (w->_index_len ? 2*(size_t)w->_index_len : 1)*sizeof(uint64_t));
+
+      // The trace can't be completed without its index
+      if(index == NULL) {
+        w->_failed = 1;
+        return;
+      }
+
+      w->_index = index;
+    }
+
+    w->_index[w->_index_len++] = w->_offset;
+    ctm_bitset_clear(w->_prev, w->_words);
+  }
+
+  // Positions are written after the count, which isn't
+  // known until they are, so they start past the longest
+  // count
+  uint8_t* p = w->_record + CTM_VARINT_MAX_BYTES;
+  uint32_t count = 0;
+  uint32_t last = 0;
+
+  for(uint32_t i = 0; i < w->_words; i++) {
+    CtmBitWord diff = bits[i] ^ w->_prev[i];
+
+    while(diff) {
+      const uint32_t pos = i*CTM_BITS_PER_WORD + ctm_bitword_lowest(diff);
+      diff &= diff - 1;
+
+      p += ctm_put_varint(p, count == 0 ? pos : pos - last - 1);
+      last = pos;
+      count++;
+    }
+  }
+
+  uint8_t head[CTM_VARINT_MAX_BYTES];
+  const uint8_t head_len = ctm_put_varint(head, count);
+  uint8_t* const record = w->_record + CTM_VARINT_MAX_BYTES - head_len;
+  const size_t len = (size_t)(p - record);
+
+  memcpy(record, head, head_len);
+
+  if(fwrite(record, len, 1, w->_file) != 1) {
+    w->_failed = 1;
+  }
+
+  w->_offset += len;
+  w->_ticks++;
+
+  memcpy(w->_prev, bits, w->_words*sizeof(CtmBitWord));
+}
+
+// Writer thread: drains the ring a batch at a time until
+// the trace is closed
+static void* ctm_trace_writer(void* arg) {
+  CtmTraceWriter* const w = arg;
+
+  pthread_mutex_lock(&w->_lock);
+
+  for(;;) {
+    while(w->_head - w->_tail < CTM_TRACE_BATCH && !w->_closing) {
+      pthread_cond_wait(&w->_ready, &w->_lock);
+    }
+
+    const uint32_t head = w->_head;
+    const uint32_t tail = w->_tail;
+
+    if(head == tail) {
+      break;
+    }
+
+    pthread_mutex_unlock(&w->_lock);
+
+    for(uint32_t t = tail; t != head; t++) {
+      ctm_trace_write_tick(w, w->_ring + (size_t)(t % CTM_TRACE_RING)*w->_words);
+    }
+
+    pthread_mutex_lock(&w->_lock);
+
+    w->_tail = head;
+    pthread_cond_signal(&w->_room);
+  }
+
+  pthread_mutex_unlock(&w->_lock);
+
+  return NULL;
+}
+
+// Release the writer's buffers
+static void ctm_trace_writer_free(CtmTraceWriter* const w) {
+  free(w->_ids);
+  free(w->_ring);
+  free(w->_prev);
+  free(w->_record);
+  free(w->_index);
+}
+
+// Create a trace of the given neurons, with a keyframe
+// every interval ticks; returns 0 if the file can't be
+// created or memory runs out
+uint8_t ctm_trace_open(CtmTraceWriter* const w, const char* path, const CtmId* ids, const CtmId len, const uint32_t interval) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  return 0;
+#endif
+
+  memset(w, 0, sizeof(*w));
+
+  w->len = len;
+  w->interval = interval != 0 ? interval : CTM_TRACE_INTERVAL;
+  w->_words = CTM_BITSET_WORDS(len);
+
+  w->_file = fopen(path, "wb");
+
+  if(w->_file == NULL) {
+    return 0;
+  }
+
+  CtmTraceHeader h;
+  memset(&h, 0, sizeof(h));
+
+  memcpy(h.magic, CTM_TRACE_MAGIC, 4);
+  h.version = CTM_TRACE_VERSION;
+  h.len = len;
+  h.interval = w->interval;
+
+  uint8_t ok = fwrite(&h, sizeof(h), 1, w->_file) == 1;
+
+  // The id list is written out either way
+  uint32_t* list = malloc(((size_t)len + 1)*sizeof(uint32_t));
+
+  ok = ok && list != NULL;
+
+  for(CtmId i = 0; ok && i < len; i++) {
+    list[i] = ids != NULL ? ids[i] : i;
+  }
+
+  if(ok && len > 0) {
+    ok = fwrite(list, len*sizeof(uint32_t), 1, w->_file) == 1;
+  }
+
+  free(list);
+
+  if(!ok) {
+    fclose(w->_file);
+    return 0;
+  }
+
+  if(ids != NULL) {
+    w->_ids = malloc(((size_t)len + 1)*sizeof(CtmId));
+
+    if(w->_ids != NULL) {
+      memcpy(w->_ids, ids, len*sizeof(CtmId));
+    }
+  }
+
+  w->_ring = calloc((size_t)CTM_TRACE_RING*w->_words + 1, sizeof(CtmBitWord));
+  w->_prev = calloc((size_t)w->_words + 1, sizeof(CtmBitWord));
+  w->_record = malloc(((size_t)len + 2)*CTM_VARINT_MAX_BYTES);
+  w->_offset = sizeof(h) + (uint64_t)len*sizeof(uint32_t);
+
+  if((ids != NULL && w->_ids == NULL) || w->_ring == NULL || w->_prev == NULL || w->_record == NULL) {
+    ctm_trace_writer_free(w);
+    fclose(w->_file);
+    return 0;
+  }
+
+  pthread_mutex_init(&w->_lock, NULL);
+  pthread_cond_init(&w->_ready, NULL);
+  pthread_cond_init(&w->_room, NULL);
+
+  if(pthread_create(&w->_thread, NULL, ctm_trace_writer, w) != 0) {
+    pthread_mutex_destroy(&w->_lock);
+    pthread_cond_destroy(&w->_ready);
+    pthread_cond_destroy(&w->_room);
+
+    ctm_trace_writer_free(w);
+    fclose(w->_file);
+    return 0;
+  }
+
+  return 1;
+}
+
+// Record which traced neurons discharged in the last tick
+void ctm_trace_record(CtmTraceWriter* const w, Connectome* const c) {
+  pthread_mutex_lock(&w->_lock);
+
+  while(w->_head - w->_tail == CTM_TRACE_RING) {
+    pthread_cond_wait(&w->_room, &w->_lock);
+  }
+
+  pthread_mutex_unlock(&w->_lock);
+
+  // The slot is ours until _head moves past it
+  CtmBitWord* const bits = w->_ring + (size_t)(w->_head % CTM_TRACE_RING)*w->_words;
+
+  if(w->_ids == NULL) {
+    // Leading neurons are a prefix of the discharge bits
+    memcpy(bits, c->_discharged, w->_words*sizeof(CtmBitWord));
+
+    if(w->len % CTM_BITS_PER_WORD) {
+      bits[w->_words - 1] &= ((CtmBitWord)1 << (w->len % CTM_BITS_PER_WORD)) - 1;
+    }
+  }
+  else {
+    ctm_bitset_clear(bits, w->_words);
+
+    for(CtmId i = 0; i < w->len; i++) {
+      if(ctm_get_discharge(c, w->_ids[i])) {
+        ctm_bitset_set(bits, i);
+      }
+    }
+  }
+
+  pthread_mutex_lock(&w->_lock);
+
+  w->_head++;
+
+  if(w->_head - w->_tail == CTM_TRACE_BATCH) {
+    pthread_cond_signal(&w->_ready);
+  }
+
+  pthread_mutex_unlock(&w->_lock);
+}
+
+// Write out every recorded tick and the index, and close
+// the file; returns 0 if anything failed to be written
+uint8_t ctm_trace_close(CtmTraceWriter* const w) {
+  pthread_mutex_lock(&w->_lock);
+  w->_closing = 1;
+  pthread_cond_signal(&w->_ready);
+  pthread_mutex_unlock(&w->_lock);
+
+  pthread_join(w->_thread, NULL);
+
+  CtmTraceFooter footer;
+  memset(&footer, 0, sizeof(footer));
+
+  footer.index_offset = w->_offset;
+  footer.ticks = w->_ticks;
+  memcpy(footer.magic, CTM_TRACE_INDEX_MAGIC, 4);
+
+  uint8_t ok = !w->_failed;
+
+  if(ok && w->_index_len > 0) {
+    ok = fwrite(w->_index, w->_index_len*sizeof(uint64_t), 1, w->_file) == 1;
+  }
+
+  if(ok) {
+    ok = fwrite(&footer, sizeof(footer), 1, w->_file) == 1;
+  }
+
+  if(fclose(w->_file) != 0) {
+    ok = 0;
+  }
+
+  pthread_mutex_destroy(&w->_lock);
+  pthread_cond_destroy(&w->_ready);
+  pthread_cond_destroy(&w->_room);
+
+  ctm_trace_writer_free(w);
+
+  return ok;
+}
+
+//
+// Reader
+//
+
+static uint8_t ctm_trace_get_varint(CtmTraceReader* const r, uint32_t* const v) {
+  *v = 0;
+
+  for(uint8_t shift = 0; ; shift += 7) {
+    const int b = r->_pos < r->_end ? getc(r->_file) : EOF;
+
+    if(b == EOF || shift > 28) {
+      return 0;
+    }
+
+    r->_pos++;
+    *v |= (uint32_t)(b & 0x7F) << shift;
+
+    if(b < 0x80) {
+      return 1;
+    }
+  }
+}
+
+// Open a trace for reading; returns 0 if the file can't be
+// read, isn't a trace or memory runs out
+uint8_t ctm_trace_read_open(CtmTraceReader* const r, const char* path) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  return 0;
+#endif
+
+  memset(r, 0, sizeof(*r));
+
+  r->_file = fopen(path, "rb");
+
+  if(r->_file == NULL) {
+    return 0;
+  }
+
+  CtmTraceHeader h;
+
+  if(fread(&h, sizeof(h), 1, r->_file) != 1 || memcmp(h.magic, CTM_TRACE_MAGIC, 4) != 0 || h.version != CTM_TRACE_VERSION || h.interval == 0 || (CtmId)h.len != h.len) {
+    fclose(r->_file);
+    return 0;
+  }
+
+  r->len = h.len;
+  r->interval = h.interval;
+  r->_start = sizeof(h) + (uint64_t)h.len*sizeof(uint32_t);
+
+  if(fseek(r->_file, 0, SEEK_END) != 0) {
+    fclose(r->_file);
+    return 0;
+  }
+
+  const uint64_t size = (uint64_t)ftell(r->_file);
+  r->_end = size;
+
+  // The id list has to fit before anything is allocated
+  if(r->_start > size) {
+    fclose(r->_file);
+    return 0;
+  }
+
+  // A complete index ends the file; otherwise records run
+  // to the end
+  CtmTraceFooter footer;
+
+  if(size >= r->_start + sizeof(footer) && fseek(r->_file, (long)(size - sizeof(footer)), SEEK_SET) == 0 && fread(&footer, sizeof(footer), 1, r->_file) == 1 && memcmp(footer.magic, CTM_TRACE_INDEX_MAGIC, 4) == 0) {
+    const uint64_t entries = ((uint64_t)footer.ticks + r->interval - 1)/r->interval;
+
+    if(footer.index_offset >= r->_start && footer.index_offset + entries*sizeof(uint64_t) + sizeof(footer) == size) {
+      r->_index = malloc((entries + 1)*sizeof(uint64_t));
+
+      // Without the index, the trace reads like an
+      // unfinished one
+      if(r->_index != NULL && fseek(r->_file, (long)footer.index_offset, SEEK_SET) == 0 && fread(r->_index, sizeof(uint64_t), entries, r->_file) == entries) {
+        r->ticks = footer.ticks;
+        r->_end = footer.index_offset;
+      }
+      else {
+        free(r->_index);
+        r->_index = NULL;
+      }
+    }
+  }
+
+  r->ids = malloc(((size_t)r->len + 1)*sizeof(CtmId));
+  r->_bits = calloc(CTM_BITSET_WORDS(r->len) + 1, sizeof(CtmBitWord));
+
+  uint32_t* list = malloc(((size_t)r->len + 1)*sizeof(uint32_t));
+
+  uint8_t ok = r->ids != NULL && r->_bits != NULL && list != NULL
+    && fseek(r->_file, sizeof(h), SEEK_SET) == 0;
+
+  if(ok && r->len > 0) {
+    ok = fread(list, r->len*sizeof(uint32_t), 1, r->_file) == 1;
+  }
+
+  for(CtmId i = 0; ok && i < r->len; i++) {
+    r->ids[i] = list[i];
+  }
+
+  free(list);
+
+  r->_pos = r->_start;
+
+  if(!ok) {
+    ctm_trace_read_close(r);
+    return 0;
+  }
+
+  return 1;
+}
+
+// Read the next tick's discharge bits; returns 0 at the end
+// of the trace or if it is malformed
+uint8_t ctm_trace_read(CtmTraceReader* const r, CtmBitWord* const bits) {
+  const uint32_t words = CTM_BITSET_WORDS(r->len);
+
+  if(r->_pos >= r->_end || (r->_index != NULL && r->tick >= r->ticks)) {
+    return 0;
+  }
+
+  if(r->tick % r->interval == 0) {
+    ctm_bitset_clear(r->_bits, words);
+  }
+
+  uint32_t count;
+
+  if(!ctm_trace_get_varint(r, &count)) {
+    return 0;
+  }
+
+  uint32_t pos = 0;
+
+  for(uint32_t i = 0; i < count; i++) {
+    uint32_t gap;
+
+    if(!ctm_trace_get_varint(r, &gap)) {
+      return 0;
+    }
+
+    pos = i == 0 ? gap : pos + gap + 1;
+
+    if(pos >= r->len || (i > 0 && gap >= r->len)) {
+      return 0;
+    }
+
+    r->_bits[pos/CTM_BITS_PER_WORD] ^= (CtmBitWord)1 << (pos % CTM_BITS_PER_WORD);
+  }
+
+  memcpy(bits, r->_bits, words*sizeof(CtmBitWord));
+  r->tick++;
+
+  return 1;
+}
+
+// Position the reader so the next read returns the given
+// tick; returns 0 if the trace doesn't reach it
+uint8_t ctm_trace_seek(CtmTraceReader* const r, const uint32_t tick) {
+  uint32_t from = 0;
+  uint64_t offset = r->_start;
+
+  if(r->_index != NULL) {
+    if(tick > r->ticks) {
+      return 0;
+    }
+
+    from = tick/r->interval*r->interval;
+
+    if(from < r->ticks) {
+      offset = r->_index[tick/r->interval];
+    }
+    else {
+      from = r->ticks;
+      offset = r->_end;
+    }
+  }
+
+  if(offset < r->_start || offset > r->_end || fseek(r->_file, (long)offset, SEEK_SET) != 0) {
+    return 0;
+  }
+
+  r->_pos = offset;
+  r->tick = from;
+
+  // Records between the keyframe and the tick are decoded
+  // and dropped
+  CtmBitWord* scratch = malloc((CTM_BITSET_WORDS(r->len) + 1)*sizeof(CtmBitWord));
+  uint8_t ok = 1;
+
+  while(ok && r->tick < tick) {
+    ok = ctm_trace_read(r, scratch);
+  }
+
+  free(scratch);
+
+  return ok;
+}
+
+void ctm_trace_read_close(CtmTraceReader* const r) {
+  fclose(r->_file);
+  free(r->ids);
+  free(r->_index);
+  free(r->_bits);
+}
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "defines.h"
+#include "connectome.h"
+#include "bitset.h"
+
+#ifdef CTM_TRACE
+
+//
+// Binary discharge traces
+//
+// A trace records which of a chosen list of neurons
+// discharged, tick by tick. Recording only copies the
+// discharge bits into a ring buffer; a background thread
+// encodes them and writes them out.
+//
+// All fields are little-endian:
+//
+// Header (CtmTraceHeader), followed by the traced neuron
+// ids (32 bits each)
+//
+// One record per tick: a varint count of the traced
+// neurons whose discharge bit differs from the previous
+// tick, then their positions in the id list, in increasing
+// order, as varints of the gap from the previous one (minus
+// one; the first is the position itself). Every interval
+// ticks, starting at tick zero, a keyframe record is coded
+// against an all-clear previous tick instead.
+//
+// Index: a 64-bit file offset of each keyframe record,
+// then a footer (CtmTraceFooter). Traces whose writer
+// didn't finish have no index, but can still be read from
+// the start.
+//
+// Varints hold seven bits per byte, low bits first, with
+// the high bit set on every byte but the last.
+//
+
+#define CTM_TRACE_MAGIC "CTMT"
+#define CTM_TRACE_INDEX_MAGIC "CTMI"
+#define CTM_TRACE_VERSION 1
+
+// Ticks buffered between the simulation and the writer
+// thread (recording only waits if they are all in use),
+// and how many are left to gather before it is woken
+#define CTM_TRACE_RING 1024
+#define CTM_TRACE_BATCH 64
+
+// Default ticks between keyframes
+#define CTM_TRACE_INTERVAL 1024
+
+typedef struct {
+  char magic[4];
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t len;
+  uint32_t interval;
+} CtmTraceHeader;
+
+typedef struct {
+  uint64_t index_offset;
+  uint32_t ticks;
+  char magic[4];
+} CtmTraceFooter;
+
+//
+// Trace writer
+//
+
+typedef struct {
+  // Number of traced neurons, and their ids (NULL for
+  // neurons 0 through len - 1)
+  CtmId len;
+  CtmId* _ids;
+
+  // Ticks between keyframes
+  uint32_t interval;
+
+  FILE* _file;
+
+  // Ring of discharge bitsets, _words words each; ticks
+  // _tail through _head - 1 are waiting to be written
+  CtmBitWord* _ring;
+  uint32_t _words;
+  uint32_t _head;
+  uint32_t _tail;
+
+  pthread_t _thread;
+  pthread_mutex_t _lock;
+  pthread_cond_t _ready;
+  pthread_cond_t _room;
+  uint8_t _closing;
+
+  //
+  // Writer thread only
+  //
+
+  // Ticks written, the previous tick's bits, and scratch
+  // space for a record
+  uint32_t _ticks;
+  CtmBitWord* _prev;
+  uint8_t* _record;
+
+  // Bytes written, keyframe offsets, and whether any
+  // write failed
+  uint64_t _offset;
+  uint64_t* _index;
+  uint32_t _index_len;
+  uint8_t _failed;
+} CtmTraceWriter;
+
+// Create a trace of the given neurons (NULL for neurons 0
+// through len - 1), with a keyframe every interval ticks
+// (zero for CTM_TRACE_INTERVAL); returns 0 if the file
+// can't be created or memory runs out
+uint8_t ctm_trace_open(CtmTraceWriter* const, const char*, const CtmId*, const CtmId, const uint32_t);
+
+// Record which traced neurons discharged in the last tick
+void ctm_trace_record(CtmTraceWriter* const, Connectome* const);
+
+// Write out every recorded tick and the index, and close
+// the file; returns 0 if anything failed to be written
+uint8_t ctm_trace_close(CtmTraceWriter* const);
+
+//
+// Trace reader
+//
+
+typedef struct {
+  // Number of traced neurons and their ids
+  CtmId len;
+  CtmId* ids;
+
+  // Ticks between keyframes
+  uint32_t interval;
+
+  // Number of ticks (zero for a trace without an index,
+  // which are read until they run out)
+  uint32_t ticks;
+
+  // Tick the next read returns
+  uint32_t tick;
+
+  FILE* _file;
+
+  // Offsets of the first record and of the end of the
+  // records, and the offset read up to
+  uint64_t _start;
+  uint64_t _end;
+  uint64_t _pos;
+
+  // Keyframe offsets (NULL without an index)
+  uint64_t* _index;
+
+  // Bits of the last tick read
+  CtmBitWord* _bits;
+} CtmTraceReader;
+
+// Open a trace for reading; returns 0 if the file can't be
+// read, isn't a trace or memory runs out
+uint8_t ctm_trace_read_open(CtmTraceReader* const, const char*);
+
+// Read the next tick's discharge bits (one per traced
+// neuron, in id list order); returns 0 at the end of the
+// trace or if it is malformed
+uint8_t ctm_trace_read(CtmTraceReader* const, CtmBitWord* const);
+
+// Position the reader so the next read returns the given
+// tick, decoding from the keyframe before it; returns 0 if
+// the trace doesn't reach it
+uint8_t ctm_trace_seek(CtmTraceReader* const, const uint32_t);
+
+void ctm_trace_read_close(CtmTraceReader* const);
+
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+#include "wide_rom.h"
+
+#ifdef CTM_WIDE_NETWORKS
+
+// Encode one connection following the given previous target
+// (zero for the first in a run); returns the number of
+// bytes written
+uint8_t ctm_wide_put(uint8_t* out, const CtmId prev, const CtmId target, const CtmWeight weight) {
+  // Differences wrap, so any target follows any other
+  const int32_t delta = (int32_t)(target - prev);
+  uint32_t zz = ((uint32_t)delta << 1) ^ (uint32_t)-(int32_t)((uint32_t)delta >> 31);
+  uint8_t n = 0;
+
+  while(zz >= 0x80) {
+    out[n++] = (uint8_t)(zz | 0x80);
+    zz >>= 7;
+  }
+  out[n++] = (uint8_t)zz;
+
+  out[n++] = (uint8_t)((uint16_t)weight & 0xFF);
+  out[n++] = (uint8_t)((uint16_t)weight >> 8);
+
+  return n;
+}
+
+// Decode every run into compressed-sparse-row arrays
+// (rows + 1 offsets, then len targets and weights); returns 0
+// if the data are malformed or connect to cells that don't
+// exist
+uint8_t ctm_wide_decode(const uint32_t* index, const uint8_t* data, const uint32_t size, const CtmId rows, const CtmId cells, const uint32_t len, uint32_t* row_offset, CtmId* target, CtmWeight* weight) {
+  if(index[0] != 0 || index[rows] != size) {
+    return 0;
+  }
+
+  uint32_t n = 0;
+
+  for(CtmId row = 0; row < rows; row++) {
+    if(index[row + 1] < index[row] || index[row + 1] > size) {
+      return 0;
+    }
+
+    const uint8_t* p = data + index[row];
+    const uint8_t* const end = data + index[row + 1];
+
+    row_offset[row] = n;
+
+    CtmId prev = 0;
+
+    while(p < end) {
+      uint32_t zz;
+
+      // Differences under 64 take a single byte
+      if(p[0] < 0x80) {
+        zz = p[0];
+        p++;
+      }
+      else {
+        zz = 0;
+
+        for(uint8_t shift = 0; ; shift += 7) {
+          if(p == end || shift > 28) {
+            return 0;
+          }
+
+          zz |= (uint32_t)(p[0] & 0x7F) << shift;
+
+          if(*p++ < 0x80) {
+            break;
+          }
+        }
+      }
+
+      if(end - p < 2 || n == len) {
+        return 0;
+      }
+
+      const CtmId id = prev + (CtmId)((zz >> 1) ^ -(zz & 1));
+
+      if(id >= cells) {
+        return 0;
+      }
+
+      target[n] = id;
+      weight[n] = (CtmWeight)(uint16_t)(p[0] | (p[1] << 8));
+      n++;
+
+      prev = id;
+      p += 2;
+    }
+  }
+
+  row_offset[rows] = n;
+
+  return n == len;
+}
+
+#endif
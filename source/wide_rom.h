@@ -0,0 +1,47 @@
+#ifndef WIDEROM_H
+#define WIDEROM_H
+
+#include <stdint.h>
+
+#include "defines.h"
+#include "neural_rom.h"
+
+#ifdef CTM_WIDE_NETWORKS
+
+//
+// Wide connectome encoding
+//
+// Lifts the 9-bit id and 7-bit weight limits of the ROM
+// format. The connections of each neuron are a run of
+// bytes, one connection after another:
+//
+// Target id: varint of the zigzag-coded difference from the
+// previous target in the run (from zero for the first one)
+// Weight: 16-bit little-endian signed integer
+//
+// Varints hold seven bits per byte, low bits first, with the
+// high bit set on every byte but the last. Connections keep
+// their order, so targets needn't be sorted, but runs of
+// nearby targets take one byte per id.
+//
+// An index of (neurons + 1) byte offsets gives the start of
+// each run, the last one being the total size.
+//
+
+// Longest encoding of a single connection
+#define CTM_WIDE_MAX_BYTES 7
+
+// Encode one connection following the given previous target
+// (zero for the first in a run); returns the number of
+// bytes written
+uint8_t ctm_wide_put(uint8_t*, const CtmId, const CtmId, const CtmWeight);
+
+// Decode every run into compressed-sparse-row arrays
+// (rows + 1 offsets, then len targets and weights); returns 0
+// if the data are malformed or connect to cells that don't
+// exist
+uint8_t ctm_wide_decode(const uint32_t*, const uint8_t*, const uint32_t, const CtmId, const CtmId, const uint32_t, uint32_t*, CtmId*, CtmWeight*);
+
+#endif
+
+#endif
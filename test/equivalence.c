@@ -0,0 +1,634 @@
+// Equivalence test of the simulation's alternative paths
+//
+// Runs simulations in every mode, with every thread count
+// and driven in every way next to a plain one (pushing
+// discharges on a single thread, one ctm_neural_cycle per
+// tick) under the same schedule of stimuli, and compares
+// their neuron states, muscle states and discharges after
+// every tick:
+//
+// - Event-driven and pull modes, alone and together
+// - Two to four threads
+// - Registered stimuli, applied exactly
+// - ctm_run, with listed and registered stimuli
+// - Simulations saved to snapshots at several points
+//   (before, at and after the parameter switch below), and
+//   restored in another mode
+// - A simulation whose mode and thread count keep changing
+//
+// Halfway through, every simulation switches to narrower
+// parameters. Deferred saturation doesn't give the same
+// results as the default mode, so its variants (fast
+// stimuli included) are compared with a plain simulation
+// in that mode. Ensembles, which keep the compiled-in
+// parameters, are compared instance by instance with
+// plain simulations under different stimuli.
+//
+// The compiled-in network is tested first, then a
+// synthetic one (see synthetic.h), each over several
+// numbers of ticks.
+//
+// Compile with:
+// gcc -O2 -I./source -o ./nanotode_equivalence test/equivalence.c source/*.c -lpthread -lm
+//
+// Usage:
+// nanotode_equivalence [-t ticks] [-n neurons]
+//
+// -t: Comma-separated numbers of ticks to run each test
+//     for (defaults to 1000,1500,3000)
+// -n: Neurons of the synthetic network (defaults to 2000;
+//     zero skips it)
+//
+// Prints each divergence, with the first tick it shows up
+// in, and exits with 1 if there was any.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "defines.h"
+#include "connectome.h"
+#include "ensemble.h"
+#include "synthetic.h"
+
+#define LEN(a) (sizeof(a)/sizeof((a)[0]))
+
+// Stimuli cycled through: two lists (the second with a
+// duplicate id) and none
+#define STIMULI 3
+
+// Ticks each stimulus lasts
+static const uint32_t phase_ticks[STIMULI] = { 200, 150, 100 };
+
+// Numbers of ticks tested by default, and the most that
+// can be given
+static const uint64_t default_ticks[] = { 1000, 1500, 3000 };
+#define TICKS_MAX 16
+
+typedef struct {
+  CtmId ids[STIMULI][10];
+  CtmId len[STIMULI];
+} Stimuli;
+
+// Spread the stimuli over a network's neurons
+static void stimuli_init(Stimuli* const s, const CtmNetwork* const net) {
+  const CtmId n = net->neurons;
+
+  s->len[0] = 8;
+  s->len[1] = 10;
+  s->len[2] = 0;
+
+  for(CtmId i = 0; i < s->len[0]; i++) {
+    s->ids[0][i] = (CtmId)((uint64_t)n*i/s->len[0]);
+  }
+
+  for(CtmId i = 0; i < s->len[1]; i++) {
+    s->ids[1][i] = (CtmId)((uint64_t)n*(2*i + 1)/(2*s->len[1]));
+  }
+
+  s->ids[1][s->len[1] - 1] = s->ids[1][0];
+}
+
+// Stimulus applied at the given tick
+static uint32_t stimulus_at(const uint64_t t) {
+  uint64_t left = t % (phase_ticks[0] + phase_ticks[1] + phase_ticks[2]);
+  uint32_t k = 0;
+
+  while(left >= phase_ticks[k]) {
+    left -= phase_ticks[k];
+    k++;
+  }
+
+  return k;
+}
+
+// Whether two simulations of the same network are in the
+// same state
+static uint8_t same_state(Connectome* const a, Connectome* const b, const CtmNetwork* const net) {
+  const CtmId muscles = net->cells - net->neurons;
+
+  if(memcmp(ctm_neuron_state(a), ctm_neuron_state(b), net->neurons) != 0) {
+    return 0;
+  }
+
+  if(memcmp(ctm_muscle_state(a), ctm_muscle_state(b), muscles*sizeof(int16_t)) != 0) {
+    return 0;
+  }
+
+  for(CtmId i = 0; i < net->neurons; i++) {
+    if(ctm_get_discharge(a, i) != ctm_get_discharge(b, i)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+//
+// Simulations compared with the plain one
+//
+
+typedef struct {
+  const char* name;
+
+  // Mode (on top of the test's) and number of threads
+  uint8_t mode;
+  uint16_t threads;
+
+  // Stimuli are applied through registered handles
+  uint8_t cached;
+
+  // Restored from a snapshot ahead of tick ticks/restore +
+  // restore_shift (never if restore is zero), in the mode
+  // given (on top of the test's)
+  uint8_t restore;
+  int32_t restore_shift;
+  uint8_t restore_mode;
+
+  // Mode and thread count change as it runs
+  uint8_t switching;
+
+  Connectome c;
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+  CtmStimulus handle[STIMULI];
+#endif
+
+  // First tick it diverged in, plus one (zero if it
+  // hasn't)
+  uint64_t diverged;
+} Variant;
+
+#ifdef CTM_FRONTIER
+static const Variant variant_list[] = {
+  { .name = "event-driven", .mode = CTM_MODE_EVENT_DRIVEN },
+  { .name = "pull", .mode = CTM_MODE_PULL },
+  { .name = "event-driven pull", .mode = CTM_MODE_EVENT_DRIVEN | CTM_MODE_PULL },
+#ifdef CTM_PARALLEL
+  { .name = "2 threads", .threads = 2 },
+  { .name = "3 threads, event-driven", .mode = CTM_MODE_EVENT_DRIVEN, .threads = 3 },
+  { .name = "4 threads, event-driven pull", .mode = CTM_MODE_EVENT_DRIVEN | CTM_MODE_PULL, .threads = 4 },
+#endif
+#ifdef CTM_STIMULUS_CACHE
+  { .name = "registered stimuli", .cached = 1 },
+  { .name = "registered stimuli, event-driven pull", .mode = CTM_MODE_EVENT_DRIVEN | CTM_MODE_PULL, .cached = 1 },
+#endif
+  { .name = "switching modes and threads", .switching = 1 }
+};
+#endif
+
+#ifdef CTM_SNAPSHOT
+// Snapshots taken a third of the way in, either side of
+// the parameter switch, and well after it
+static const Variant restore_list[] = {
+  { .name = "restored a third of the way in", .mode = CTM_MODE_EVENT_DRIVEN, .restore = 3, .restore_mode = CTM_MODE_PULL },
+  { .name = "restored just before the switch", .restore = 2, .restore_shift = -1, .restore_mode = CTM_MODE_EVENT_DRIVEN },
+  { .name = "restored at the switch", .mode = CTM_MODE_PULL, .restore = 2 },
+  { .name = "restored just after the switch", .mode = CTM_MODE_EVENT_DRIVEN, .restore = 2, .restore_shift = 3 },
+  { .name = "restored well after the switch", .restore = 2, .restore_shift = 40, .restore_mode = CTM_MODE_EVENT_DRIVEN | CTM_MODE_PULL }
+};
+#endif
+
+// Mode and thread count of a switching simulation from
+// the given tick on
+#ifdef CTM_FRONTIER
+static void variant_switch(Variant* const v, const uint8_t base, const uint64_t t) {
+  static const uint8_t modes[] = {
+    CTM_MODE_EVENT_DRIVEN, CTM_MODE_PULL, 0, CTM_MODE_EVENT_DRIVEN | CTM_MODE_PULL
+  };
+
+  if(t % 97 == 0) {
+    ctm_set_mode(&v->c, base | modes[t/97 % LEN(modes)]);
+  }
+
+#ifdef CTM_PARALLEL
+  if(t % 131 == 0) {
+    ctm_set_threads(&v->c, (uint16_t)(1 + t/131 % 3));
+  }
+#endif
+}
+#endif
+
+#ifdef CTM_SNAPSHOT
+// Replace a simulation with one restored from a snapshot
+// of it, in another mode; returns 0 on failure
+static uint8_t variant_restore(Variant* const v, const CtmNetwork* const net, const uint8_t base) {
+  const size_t size = ctm_state_size(&v->c);
+  void* buf = malloc(size);
+
+  uint8_t ok = buf != NULL && ctm_save_state(&v->c, buf, size);
+
+  ctm_free(&v->c);
+
+  if(!ctm_init(&v->c, net)) {
+    free(buf);
+    return 0;
+  }
+
+#ifdef CTM_FRONTIER
+  ctm_set_mode(&v->c, base | v->restore_mode);
+#else
+  (void)base;
+#endif
+
+  ok = ok && ctm_load_state(&v->c, buf, size);
+
+  free(buf);
+
+  return ok;
+}
+#endif
+
+//
+// One test: a plain simulation, the variants, and a
+// simulation driven by ctm_run, whose observer steps all
+// the others in lockstep with it
+//
+
+typedef struct {
+  const CtmNetwork* net;
+  const Stimuli* stimuli;
+  uint8_t mode;
+  uint64_t ticks;
+
+  Connectome plain;
+  Connectome run;
+  uint64_t run_diverged;
+
+  Variant* variants;
+  uint32_t len;
+
+  // Parameters switched to halfway through
+  CtmParams narrow;
+} Test;
+
+// Run one tick of a variant
+static void variant_tick(Test* const test, Variant* const v, const uint64_t t) {
+  const uint32_t k = stimulus_at(t);
+
+#ifdef CTM_FRONTIER
+  if(v->switching) {
+    variant_switch(v, test->mode, t);
+  }
+#endif
+
+#ifdef CTM_SNAPSHOT
+  if(v->restore != 0 && t == (uint64_t)((int64_t)(test->ticks/v->restore) + v->restore_shift) && !variant_restore(v, test->net, test->mode)) {
+    fprintf(stderr, "%s: can't restore from a snapshot\n", v->name);
+    v->diverged = v->diverged != 0 ? v->diverged : t + 1;
+  }
+#endif
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+  if(v->cached) {
+    ctm_stimulus_cycle(&v->c, v->handle[k]);
+    return;
+  }
+#endif
+
+  ctm_neural_cycle(&v->c, test->stimuli->ids[k], test->stimuli->len[k]);
+}
+
+// Observer of the ctm_run simulation: runs the same tick
+// of every other simulation, compares them, and switches
+// all of them to narrower parameters halfway through
+static uint8_t test_tick(Connectome* const run, const uint64_t ticks, void* arg) {
+  Test* const test = arg;
+  const uint64_t t = ticks - 1;
+  const uint32_t k = stimulus_at(t);
+
+  ctm_neural_cycle(&test->plain, test->stimuli->ids[k], test->stimuli->len[k]);
+
+  if(test->run_diverged == 0 && !same_state(run, &test->plain, test->net)) {
+    test->run_diverged = ticks;
+  }
+
+  for(uint32_t i = 0; i < test->len; i++) {
+    Variant* const v = &test->variants[i];
+
+    variant_tick(test, v, t);
+
+    if(v->diverged == 0 && !same_state(&v->c, &test->plain, test->net)) {
+      v->diverged = ticks;
+    }
+  }
+
+  if(ticks == test->ticks/2) {
+    ctm_set_params(&test->plain, &test->narrow);
+    ctm_set_params(run, &test->narrow);
+
+    for(uint32_t i = 0; i < test->len; i++) {
+      ctm_set_params(&test->variants[i].c, &test->narrow);
+    }
+  }
+
+  return 1;
+}
+
+// Run a test in the given mode; returns the number of
+// simulations that diverged
+static uint32_t test_run(const CtmNetwork* const net, const char* label, const uint8_t mode, const uint64_t ticks) {
+  Stimuli stimuli;
+  stimuli_init(&stimuli, net);
+
+  Test test;
+  memset(&test, 0, sizeof(test));
+
+  test.net = net;
+  test.stimuli = &stimuli;
+  test.mode = mode;
+  test.ticks = ticks;
+
+  ctm_default_params(&test.narrow);
+  test.narrow.threshold = 20;
+  test.narrow.max_idle = 6;
+  test.narrow.neuron_min = -40;
+  test.narrow.neuron_max = 50;
+
+  Variant variants[32];
+  uint32_t len = 0;
+
+#ifdef CTM_FRONTIER
+  for(uint32_t i = 0; i < LEN(variant_list); i++) {
+    variants[len++] = variant_list[i];
+  }
+
+#ifdef CTM_STIMULUS_CACHE
+  // Fast stimuli are only the same as exact ones under
+  // deferred saturation
+  if(mode & CTM_MODE_DEFERRED_SATURATION) {
+    variants[len] = (Variant){ .name = "fast registered stimuli", .mode = CTM_MODE_FAST_STIMULUS, .cached = 1 };
+    len++;
+  }
+#endif
+#endif
+
+#ifdef CTM_SNAPSHOT
+  for(uint32_t i = 0; i < LEN(restore_list); i++) {
+    variants[len++] = restore_list[i];
+  }
+#endif
+
+  test.variants = variants;
+  test.len = len;
+
+  if(!ctm_init(&test.plain, net) || !ctm_init(&test.run, net)) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+#ifdef CTM_FRONTIER
+  ctm_set_mode(&test.plain, mode);
+  ctm_set_mode(&test.run, mode);
+#endif
+
+  for(uint32_t i = 0; i < len; i++) {
+    Variant* const v = &variants[i];
+
+    if(!ctm_init(&v->c, net)) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+
+#ifdef CTM_FRONTIER
+    ctm_set_mode(&v->c, mode | v->mode);
+#endif
+
+#if defined(CTM_FRONTIER) && defined(CTM_PARALLEL)
+    if(v->threads > 1 && !ctm_set_threads(&v->c, v->threads)) {
+      fprintf(stderr, "%s: can't start threads, running on one\n", v->name);
+    }
+#endif
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+    for(uint32_t k = 0; v->cached && k < STIMULI; k++) {
+      v->handle[k] = stimuli.len[k] > 0 ? ctm_register_stimulus(&v->c, stimuli.ids[k], stimuli.len[k]) : 0;
+
+      if(stimuli.len[k] > 0 && v->handle[k] == 0) {
+        fprintf(stderr, "%s: can't register stimuli\n", v->name);
+        v->diverged = 1;
+      }
+    }
+#endif
+  }
+
+  // The ctm_run simulation mixes listed and registered
+  // stimuli
+  CtmSchedulePhase schedule[STIMULI];
+  memset(schedule, 0, sizeof(schedule));
+
+  for(uint32_t k = 0; k < STIMULI; k++) {
+    schedule[k].stimulus = stimuli.len[k] > 0 ? stimuli.ids[k] : NULL;
+    schedule[k].len = stimuli.len[k];
+    schedule[k].ticks = phase_ticks[k];
+  }
+
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+  schedule[1].cached = ctm_register_stimulus(&test.run, stimuli.ids[1], stimuli.len[1]);
+
+  if(schedule[1].cached == 0) {
+    test.run_diverged = 1;
+  }
+#endif
+
+  CtmObserver observer;
+  memset(&observer, 0, sizeof(observer));
+
+  observer.stride = 1;
+  observer.fn = test_tick;
+  observer.arg = &test;
+
+  ctm_run(&test.run, schedule, STIMULI, ticks, &observer, 1);
+
+  uint32_t failed = 0;
+
+  if(test.run_diverged != 0) {
+    printf("%s: ctm_run diverges at tick %llu\n", label, (unsigned long long)test.run_diverged - 1);
+    failed++;
+  }
+
+  for(uint32_t i = 0; i < len; i++) {
+    if(variants[i].diverged != 0) {
+      printf("%s: %s diverges at tick %llu\n", label, variants[i].name, (unsigned long long)variants[i].diverged - 1);
+      failed++;
+    }
+
+    ctm_free(&variants[i].c);
+  }
+
+  ctm_free(&test.plain);
+  ctm_free(&test.run);
+
+  printf("%s: %u simulations over %llu ticks, %u diverged\n", label, len + 1, (unsigned long long)ticks, failed);
+
+  return failed;
+}
+
+#ifdef CTM_SYNAPSE_TABLE
+// Compare an ensemble, each instance under its own
+// stimuli, with plain simulations; returns 1 if any
+// instance diverged
+static uint32_t test_ensemble(const CtmNetwork* const net, const char* label, const uint64_t ticks) {
+  Stimuli stimuli;
+  stimuli_init(&stimuli, net);
+
+  CtmEnsemble e;
+  Connectome plain[STIMULI];
+
+  if(!ctm_ensemble_init(&e, net, STIMULI)) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  for(uint32_t k = 0; k < STIMULI; k++) {
+    if(!ctm_init(&plain[k], net)) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+
+  uint64_t diverged = 0;
+
+  for(uint64_t t = 0; t < ticks && diverged == 0; t++) {
+    CtmStimulusList list[STIMULI];
+
+    // Instance k is a stimulus ahead of instance 0
+    for(uint32_t k = 0; k < STIMULI; k++) {
+      const uint32_t s = (stimulus_at(t) + k) % STIMULI;
+
+      list[k].id = stimuli.len[s] > 0 ? stimuli.ids[s] : NULL;
+      list[k].len = stimuli.len[s];
+
+      ctm_neural_cycle(&plain[k], list[k].id, list[k].len);
+    }
+
+    ctm_ensemble_cycle(&e, list);
+
+    for(uint16_t k = 0; k < STIMULI; k++) {
+      for(CtmId i = 0; i < net->cells; i++) {
+        if(ctm_ensemble_get_weight(&e, k, i) != ctm_get_weight(&plain[k], i) ||
+           (i < net->neurons && ctm_ensemble_get_discharge(&e, k, i) != ctm_get_discharge(&plain[k], i))) {
+          diverged = t + 1;
+        }
+      }
+    }
+  }
+
+  ctm_ensemble_free(&e);
+
+  for(uint32_t k = 0; k < STIMULI; k++) {
+    ctm_free(&plain[k]);
+  }
+
+  if(diverged != 0) {
+    printf("%s: ensemble diverges at tick %llu\n", label, (unsigned long long)diverged - 1);
+    return 1;
+  }
+
+  printf("%s: ensemble of %u over %llu ticks, none diverged\n", label, STIMULI, (unsigned long long)ticks);
+
+  return 0;
+}
+#endif
+
+// Run every test on a network; returns the number of
+// divergences
+static uint32_t test_network(const CtmNetwork* const net, const char* name, const uint64_t ticks) {
+  char label[96];
+  uint32_t failed = 0;
+
+  snprintf(label, sizeof(label), "%s, default mode", name);
+  failed += test_run(net, label, 0, ticks);
+
+#ifdef CTM_FRONTIER
+  snprintf(label, sizeof(label), "%s, deferred saturation", name);
+  failed += test_run(net, label, CTM_MODE_DEFERRED_SATURATION, ticks);
+#endif
+
+#ifdef CTM_SYNAPSE_TABLE
+  failed += test_ensemble(net, name, ticks);
+#endif
+
+  return failed;
+}
+
+int main(int argc, char** argv) {
+  uint64_t ticks[TICKS_MAX];
+  uint32_t ticks_len = LEN(default_ticks);
+
+  memcpy(ticks, default_ticks, sizeof(default_ticks));
+
+  CtmId neurons = 2000;
+
+  int opt;
+
+  while((opt = getopt(argc, argv, "t:n:")) != -1) {
+    switch(opt) {
+      case 't':
+        ticks_len = 0;
+
+        for(char* p = optarg; *p != '\0' && ticks_len < TICKS_MAX; ) {
+          char* end;
+          const unsigned long long n = strtoull(p, &end, 10);
+
+          if(end == p) {
+            break;
+          }
+
+          if(n > 0) {
+            ticks[ticks_len++] = n;
+          }
+
+          p = *end == ',' ? end + 1 : end;
+        }
+        break;
+      case 'n': neurons = (CtmId)strtoul(optarg, NULL, 10); break;
+      default:
+        fprintf(stderr, "usage: %s [-t ticks] [-n neurons]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  CtmNetwork net;
+
+  if(!ctm_network_builtin(&net)) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  uint32_t failed = 0;
+
+  for(uint32_t i = 0; i < ticks_len; i++) {
+    failed += test_network(&net, "compiled-in", ticks[i]);
+  }
+
+  ctm_network_close(&net);
+
+#if defined(CTM_SYNAPSE_TABLE) && defined(CTM_WIDE_NETWORKS)
+  if(neurons > 0) {
+    CtmSyntheticParams params;
+    ctm_synthetic_default_params(&params, NULL, neurons);
+
+    CtmNetwork synthetic;
+
+    if(!ctm_network_synthetic(&synthetic, &params)) {
+      fprintf(stderr, "can't generate a network of %u neurons\n", (unsigned)neurons);
+      return 1;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "synthetic (%u neurons)", (unsigned)neurons);
+
+    for(uint32_t i = 0; i < ticks_len; i++) {
+      failed += test_network(&synthetic, name, ticks[i]);
+    }
+
+    ctm_network_close(&synthetic);
+  }
+#else
+  (void)neurons;
+#endif
+
+  return failed > 0;
+}
@@ -1,7 +1,7 @@
 // Simple test of connectome interfaces
 //
 // Compile with:
-// gcc -ggdb -I./source -o ./nanotode_test test/main.c source/muscles.c source/connectome.c source/neural_rom.c
+// gcc -ggdb -I./source -o ./nanotode_test test/main.c source/muscles.c source/connectome.c source/neural_rom.c source/synapse_table.c source/kernels.c source/network.c source/wide_rom.c source/trace.c source/pool.c -lpthread
 //
 
 #include <stdio.h>
@@ -9,6 +9,7 @@
 #include "defines.h"
 #include "connectome.h"
 #include "muscles.h"
+#include "trace.h"
 
 void print_motor_ab_discharges(FILE* const f, const uint8_t* a, const uint8_t* b) {
   for(uint8_t i = 0; i < MOTOR_A; i++) {
@@ -20,57 +21,113 @@ void print_motor_ab_discharges(FILE* const f, const uint8_t* a, const uint8_t* b
   fprintf(f, "%d\n", b[MOTOR_B - 1]);
 }
 
+#ifdef CTM_TRACE
+// Observer recording each tick into a trace
+uint8_t record_trace(Connectome* const c, const uint64_t ticks, void* trace) {
+  (void)ticks;
+
+  ctm_trace_record(trace, c);
+  return 1;
+}
+#endif
+
 int main() {
   // Open file for writing
   FILE* file = fopen("motor_ab.dat", "w");
   
   // Arrays for neurons describing 'nose touch' and
   // food-seeking behaviors
-  const uint16_t nose_touch[] = {
+  const CtmId nose_touch[] = {
     N_FLPR, N_FLPL, N_ASHL, N_ASHR, N_IL1VL, N_IL1VR,
     N_OLQDL, N_OLQDR, N_OLQVR, N_OLQVL
   };
 
-  const uint16_t chemotaxis[] = {
+  const CtmId chemotaxis[] = {
     N_ADFL, N_ADFR, N_ASGR, N_ASGL, N_ASIL, N_ASIR,
     N_ASJR, N_ASJL
   };
 
+  // Use the compiled-in connectome
+  CtmNetwork network;
+
+  if(!ctm_network_builtin(&network)) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
   // Create connectome struct
   Connectome connectome;
 
   // Initialize struct
-  ctm_init(&connectome);
+  ctm_init(&connectome, &network);
 
   // Perform burn-in
-  for(uint16_t i = 0; i < 1000; i++) {
-    ctm_neural_cycle(&connectome, chemotaxis, 8);
-  }
+  const CtmSchedulePhase burn_in = { .stimulus = chemotaxis, .len = 8, .ticks = 1000 };
+  ctm_run(&connectome, &burn_in, 1, 1000, NULL, 0);
 
   double motor_neuron_avg = 5.25;
 
-  // Query final state for which A and B motor
-  // neurons discharged
-  uint8_t motor_a_result[MOTOR_A];
-  uint8_t motor_b_result[MOTOR_B];
+  // A and B motor neurons, whose discharges are recorded
+  // after every tick
+  CtmId motor_ab[MOTOR_A + MOTOR_B];
+  memcpy(motor_ab, motor_neuron_a, MOTOR_A*sizeof(CtmId));
+  memcpy(motor_ab + MOTOR_A, motor_neuron_b, MOTOR_B*sizeof(CtmId));
 
-  // Run c. elegans emulation
-  // (100 neural cycles of each behavior)
-  for(uint16_t i = 0; i < 1000; i++) {
-    ctm_neural_cycle(&connectome, chemotaxis, 8);
-    ctm_discharge_query(&connectome, motor_neuron_b, motor_b_result, MOTOR_B);
-    ctm_discharge_query(&connectome, motor_neuron_a, motor_a_result, MOTOR_A);
-    print_motor_ab_discharges(file, motor_a_result, motor_b_result);
+  CtmObserver observers[2];
+  memset(observers, 0, sizeof(observers));
+
+  observers[0].stride = 1;
+  observers[0].cells = motor_ab;
+  observers[0].len = MOTOR_A + MOTOR_B;
+  observers[0].discharges = malloc(2000*(MOTOR_A + MOTOR_B));
+  observers[0].capacity = 2000;
+
+#ifdef CTM_TRACE
+  // Also keep a binary trace of the same neurons (see
+  // tools/ctm_trace_dat.c to turn it into motor_ab.dat)
+  CtmTraceWriter trace;
+  const uint8_t tracing = ctm_trace_open(&trace, "motor_ab.trace", motor_ab, MOTOR_A + MOTOR_B, 0);
+
+  if(tracing) {
+    observers[1].stride = 1;
+    observers[1].fn = record_trace;
+    observers[1].arg = &trace;
+  }
+  else {
+    fprintf(stderr, "Can't create motor_ab.trace\n");
   }
+#endif
+
+  // Run c. elegans emulation
+  // (1000 neural cycles of each behavior)
+  CtmSchedulePhase schedule[] = {
+    { .stimulus = chemotaxis, .len = 8, .ticks = 1000 },
+    { .stimulus = nose_touch, .len = 10, .ticks = 1000 }
+  };
 
-  for(uint16_t i = 0; i < 1000; i++) {
-    ctm_neural_cycle(&connectome, nose_touch, 10);
-    ctm_discharge_query(&connectome, motor_neuron_b, motor_b_result, MOTOR_B);
-    ctm_discharge_query(&connectome, motor_neuron_a, motor_a_result, MOTOR_A);
-    print_motor_ab_discharges(file, motor_a_result, motor_b_result);
+#if defined(CTM_FRONTIER) && defined(CTM_STIMULUS_CACHE)
+  // Both stimuli are applied from precompiled sums (with
+  // the same results)
+  schedule[0].cached = ctm_register_stimulus(&connectome, chemotaxis, 8);
+  schedule[1].cached = ctm_register_stimulus(&connectome, nose_touch, 10);
+#endif
+
+  ctm_run(&connectome, schedule, 2, 2000, observers, sizeof(observers)/sizeof(observers[0]));
+
+  for(uint32_t i = 0; i < observers[0].samples; i++) {
+    const uint8_t* a = observers[0].discharges + i*(MOTOR_A + MOTOR_B);
+    print_motor_ab_discharges(file, a, a + MOTOR_A);
   }
 
+  free(observers[0].discharges);
+
+#ifdef CTM_TRACE
+  if(tracing) {
+    ctm_trace_close(&trace);
+  }
+#endif
 
+  ctm_free(&connectome);
 
   fclose(file);
   return 0;
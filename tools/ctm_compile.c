@@ -0,0 +1,739 @@
+// Connectome compiler
+//
+// Reads the OpenWorm connectome tables directly and emits,
+// in one deterministic pass, the compiled-in ROM source
+// (neural_rom.c), the cell id defines and/or a binary
+// connectome file (see network.h)
+//
+// Cells with outgoing connections (neurons) get the lowest
+// ids, in name order, followed by the rest (muscles). Each
+// neuron's connections keep the order in which they first
+// appear in the tables; a connection listed twice takes the
+// weight of its last listing. Weights are connection counts,
+// negated for GABA.
+//
+// Compile with:
+// gcc -O2 -I./source -o ./ctm_compile tools/ctm_compile.c source/network.c source/synapse_table.c source/wide_rom.c source/neural_rom.c
+//
+// Usage:
+// ctm_compile [-c connectome.csv] [-m muscle.csv] [-r neural_rom.c]
+//             [-d cell_ids.h] [-b network.ctm] [-w] [-l] [-v]
+//
+// -c, -m: Neuron and muscle tables (default to the ones in
+//         CElegansNeuronTables)
+// -r: Write the ROM source
+// -d: Write the CELLS and N_* defines
+// -b: Write a binary connectome file (compact encoding
+//     unless -w is given)
+// -w: Use the wide encoding for the binary file
+// -l: Order neurons so that connected neurons have nearby
+//     ids (reverse Cuthill-McKee) rather than by name
+// -v: Print a summary of the network
+//
+// Outputs are checked against the limits of their encoding
+// (cell ids, weights and ROM size) before anything is written
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "defines.h"
+#include "network.h"
+
+#define LINE_LEN 1024
+#define FIELDS_MAX 8
+
+//
+// Cells, by name
+//
+
+typedef struct {
+  char** name;
+  uint32_t len;
+  uint32_t cap;
+
+  // Open-addressed hash of names to index + 1
+  uint32_t* slot;
+  uint32_t slots;
+} CellList;
+
+//
+// Connections, in order of first appearance
+//
+
+typedef struct {
+  uint32_t* origin;
+  uint32_t* target;
+  int32_t* weight;
+  uint32_t len;
+  uint32_t cap;
+
+  // Open-addressed hash of (origin, target) to index + 1
+  uint32_t* slot;
+  uint32_t slots;
+
+  // Connections listed more than once
+  uint32_t repeated;
+} ConnList;
+
+static void fail(const char* msg, const char* arg) {
+  fprintf(stderr, "ctm_compile: %s%s\n", msg, arg);
+  exit(1);
+}
+
+// Allocations that exit when out of memory (empty tables
+// may still come back NULL)
+static void* xmalloc(const size_t size) {
+  void* p = malloc(size);
+
+  if(p == NULL && size > 0) {
+    fail("out of memory", "");
+  }
+
+  return p;
+}
+
+static void* xcalloc(const size_t n, const size_t size) {
+  void* p = calloc(n, size);
+
+  if(p == NULL && n > 0 && size > 0) {
+    fail("out of memory", "");
+  }
+
+  return p;
+}
+
+static char* xstrdup(const char* s) {
+  char* p = strdup(s);
+
+  if(p == NULL) {
+    fail("out of memory", "");
+  }
+
+  return p;
+}
+
+static void* xrealloc(void* p, const size_t size) {
+  p = realloc(p, size);
+
+  if(p == NULL) {
+    fail("out of memory", "");
+  }
+
+  return p;
+}
+
+static uint32_t hash_name(const char* s) {
+  uint32_t h = 2166136261u;
+
+  while(*s) {
+    h = (h ^ (uint8_t)*s++)*16777619u;
+  }
+
+  return h;
+}
+
+static uint32_t hash_pair(const uint32_t a, const uint32_t b) {
+  uint64_t h = ((uint64_t)a << 32 | b)*0x9E3779B97F4A7C15ull;
+
+  return (uint32_t)(h >> 32);
+}
+
+// Index of a cell, added if it isn't known yet
+static uint32_t cell_index(CellList* const cells, const char* name) {
+  if(2*(cells->len + 1) > cells->slots) {
+    const uint32_t slots = cells->slots ? 2*cells->slots : 1024;
+
+    cells->slot = xrealloc(cells->slot, slots*sizeof(uint32_t));
+    cells->slots = slots;
+    memset(cells->slot, 0, slots*sizeof(uint32_t));
+
+    for(uint32_t i = 0; i < cells->len; i++) {
+      uint32_t s = hash_name(cells->name[i]) & (slots - 1);
+
+      while(cells->slot[s]) {
+        s = (s + 1) & (slots - 1);
+      }
+      cells->slot[s] = i + 1;
+    }
+  }
+
+  uint32_t s = hash_name(name) & (cells->slots - 1);
+
+  while(cells->slot[s]) {
+    if(strcmp(cells->name[cells->slot[s] - 1], name) == 0) {
+      return cells->slot[s] - 1;
+    }
+    s = (s + 1) & (cells->slots - 1);
+  }
+
+  if(cells->len == cells->cap) {
+    cells->cap = cells->cap ? 2*cells->cap : 512;
+    cells->name = xrealloc(cells->name, cells->cap*sizeof(char*));
+  }
+
+  cells->name[cells->len] = xstrdup(name);
+  cells->slot[s] = ++cells->len;
+
+  return cells->len - 1;
+}
+
+// Add a connection, or replace the weight of an existing one
+static void conn_set(ConnList* const conns, const uint32_t origin, const uint32_t target, const int32_t weight) {
+  if(2*(conns->len + 1) > conns->slots) {
+    const uint32_t slots = conns->slots ? 2*conns->slots : 8192;
+
+    conns->slot = xrealloc(conns->slot, slots*sizeof(uint32_t));
+    conns->slots = slots;
+    memset(conns->slot, 0, slots*sizeof(uint32_t));
+
+    for(uint32_t i = 0; i < conns->len; i++) {
+      uint32_t s = hash_pair(conns->origin[i], conns->target[i]) & (slots - 1);
+
+      while(conns->slot[s]) {
+        s = (s + 1) & (slots - 1);
+      }
+      conns->slot[s] = i + 1;
+    }
+  }
+
+  uint32_t s = hash_pair(origin, target) & (conns->slots - 1);
+
+  while(conns->slot[s]) {
+    const uint32_t i = conns->slot[s] - 1;
+
+    if(conns->origin[i] == origin && conns->target[i] == target) {
+      conns->weight[i] = weight;
+      conns->repeated++;
+      return;
+    }
+    s = (s + 1) & (conns->slots - 1);
+  }
+
+  if(conns->len == conns->cap) {
+    conns->cap = conns->cap ? 2*conns->cap : 4096;
+    conns->origin = xrealloc(conns->origin, conns->cap*sizeof(uint32_t));
+    conns->target = xrealloc(conns->target, conns->cap*sizeof(uint32_t));
+    conns->weight = xrealloc(conns->weight, conns->cap*sizeof(int32_t));
+  }
+
+  conns->origin[conns->len] = origin;
+  conns->target[conns->len] = target;
+  conns->weight[conns->len] = weight;
+  conns->slot[s] = ++conns->len;
+}
+
+//
+// Table parsing
+//
+
+// Split a line into comma-separated fields in place;
+// returns the number of fields
+static uint32_t split_fields(char* line, char** field) {
+  uint32_t n = 0;
+
+  line[strcspn(line, "\r\n")] = '\0';
+
+  while(n < FIELDS_MAX) {
+    field[n++] = line;
+
+    char* comma = strchr(line, ',');
+
+    if(comma == NULL) {
+      break;
+    }
+
+    *comma = '\0';
+    line = comma + 1;
+  }
+
+  return n;
+}
+
+// Read one table of origin, target, count and transmitter
+// columns (at the given positions)
+static void load_table(const char* path, const uint32_t count_col, const uint32_t nt_col, CellList* const cells, ConnList* const conns) {
+  FILE* f = fopen(path, "r");
+
+  if(f == NULL) {
+    fail("can't open ", path);
+  }
+
+  char line[LINE_LEN];
+  char* field[FIELDS_MAX];
+  uint32_t line_no = 0;
+
+  while(fgets(line, sizeof(line), f) != NULL) {
+    line_no++;
+
+    const uint32_t n = split_fields(line, field);
+
+    // Header row and blank lines
+    if(line_no == 1 || (n == 1 && field[0][0] == '\0')) {
+      continue;
+    }
+
+    char* end;
+    const long count = n > nt_col ? strtol(field[count_col], &end, 10) : 0;
+
+    if(n <= nt_col || field[0][0] == '\0' || field[1][0] == '\0' || end == field[count_col] || *end != '\0' || count < 0 || count > INT16_MAX) {
+      fprintf(stderr, "ctm_compile: %s:%u: malformed row\n", path, line_no);
+      exit(1);
+    }
+
+    const int32_t weight = strstr(field[nt_col], "GABA") != NULL ? -(int32_t)count : (int32_t)count;
+
+    const uint32_t origin = cell_index(cells, field[0]);
+    const uint32_t target = cell_index(cells, field[1]);
+
+    conn_set(conns, origin, target, weight);
+  }
+
+  fclose(f);
+}
+
+//
+// Cell ordering
+//
+
+static const CellList* sort_cells;
+static const uint32_t* sort_degree;
+
+static int by_name(const void* a, const void* b) {
+  return strcmp(sort_cells->name[*(const uint32_t*)a], sort_cells->name[*(const uint32_t*)b]);
+}
+
+static int by_degree(const void* a, const void* b) {
+  const uint32_t da = sort_degree[*(const uint32_t*)a];
+  const uint32_t db = sort_degree[*(const uint32_t*)b];
+
+  if(da != db) {
+    return da < db ? -1 : 1;
+  }
+
+  return by_name(a, b);
+}
+
+// Reorder neurons (order[0] through order[neurons - 1],
+// in name order) so that neighbours in the connection graph
+// get nearby ids
+static void order_for_locality(const CellList* const cells, const ConnList* const conns, uint32_t* order, const uint32_t neurons) {
+  const uint32_t n = cells->len;
+
+  // Position of each neuron in the name order, or n for
+  // cells that aren't neurons
+  uint32_t* pos = xmalloc(n*sizeof(uint32_t));
+
+  for(uint32_t i = 0; i < n; i++) {
+    pos[i] = n;
+  }
+  for(uint32_t i = 0; i < neurons; i++) {
+    pos[order[i]] = i;
+  }
+
+  // Undirected adjacency between neurons
+  uint32_t* offset = xcalloc(n + 1, sizeof(uint32_t));
+  uint32_t* adj = xmalloc(2*conns->len*sizeof(uint32_t));
+
+  for(uint32_t i = 0; i < conns->len; i++) {
+    if(pos[conns->origin[i]] < n && pos[conns->target[i]] < n) {
+      offset[conns->origin[i] + 1]++;
+      offset[conns->target[i] + 1]++;
+    }
+  }
+  for(uint32_t i = 0; i < n; i++) {
+    offset[i + 1] += offset[i];
+  }
+
+  uint32_t* fill = xmalloc(n*sizeof(uint32_t));
+  memcpy(fill, offset, n*sizeof(uint32_t));
+
+  for(uint32_t i = 0; i < conns->len; i++) {
+    if(pos[conns->origin[i]] < n && pos[conns->target[i]] < n) {
+      adj[fill[conns->origin[i]]++] = conns->target[i];
+      adj[fill[conns->target[i]]++] = conns->origin[i];
+    }
+  }
+
+  uint32_t* degree = xmalloc(n*sizeof(uint32_t));
+
+  for(uint32_t i = 0; i < n; i++) {
+    degree[i] = offset[i + 1] - offset[i];
+  }
+
+  sort_degree = degree;
+
+  // Breadth-first from a lowest-degree neuron of each
+  // component, visiting neighbours by increasing degree
+  uint32_t* start = xmalloc(neurons*sizeof(uint32_t));
+  memcpy(start, order, neurons*sizeof(uint32_t));
+  qsort(start, neurons, sizeof(uint32_t), by_degree);
+
+  uint8_t* seen = xcalloc(n, sizeof(uint8_t));
+  uint32_t* queue = xmalloc(neurons*sizeof(uint32_t));
+  uint32_t head = 0;
+  uint32_t tail = 0;
+
+  for(uint32_t s = 0; s < neurons; s++) {
+    if(seen[start[s]]) {
+      continue;
+    }
+
+    seen[start[s]] = 1;
+    queue[tail++] = start[s];
+
+    while(head < tail) {
+      const uint32_t cell = queue[head++];
+      const uint32_t first = tail;
+
+      for(uint32_t i = offset[cell]; i < offset[cell + 1]; i++) {
+        if(!seen[adj[i]]) {
+          seen[adj[i]] = 1;
+          queue[tail++] = adj[i];
+        }
+      }
+
+      qsort(queue + first, tail - first, sizeof(uint32_t), by_degree);
+    }
+  }
+
+  // Reversed, as Cuthill-McKee orderings usually are
+  for(uint32_t i = 0; i < neurons; i++) {
+    order[i] = queue[neurons - 1 - i];
+  }
+
+  free(pos);
+  free(offset);
+  free(adj);
+  free(fill);
+  free(degree);
+  free(start);
+  free(seen);
+  free(queue);
+}
+
+// Cell order: neurons first, then the rest, each by name
+// unless neurons are ordered for locality; returns the
+// number of neurons
+static uint32_t order_cells(const CellList* const cells, const ConnList* const conns, const uint8_t locality, uint32_t* order) {
+  uint8_t* linked = xcalloc(cells->len, sizeof(uint8_t));
+
+  for(uint32_t i = 0; i < conns->len; i++) {
+    linked[conns->origin[i]] = 1;
+  }
+
+  uint32_t neurons = 0;
+  uint32_t rest = cells->len;
+
+  for(uint32_t i = 0; i < cells->len; i++) {
+    if(linked[i]) {
+      order[neurons++] = i;
+    }
+  }
+  for(uint32_t i = cells->len; i-- > 0; ) {
+    if(!linked[i]) {
+      order[--rest] = i;
+    }
+  }
+
+  sort_cells = cells;
+  qsort(order, neurons, sizeof(uint32_t), by_name);
+  qsort(order + neurons, cells->len - neurons, sizeof(uint32_t), by_name);
+
+  if(locality) {
+    order_for_locality(cells, conns, order, neurons);
+  }
+
+  free(linked);
+
+  return neurons;
+}
+
+//
+// Limit checks
+//
+
+// Check connections against a weight range, reporting the
+// first few that fall outside it
+static uint8_t check_weights(const CellList* const cells, const ConnList* const conns, const int32_t lo, const int32_t hi, const char* encoding) {
+  uint32_t bad = 0;
+
+  for(uint32_t i = 0; i < conns->len; i++) {
+    if(conns->weight[i] < lo || conns->weight[i] > hi) {
+      if(bad++ < 10) {
+        fprintf(stderr, "ctm_compile: %s -> %s: weight %d outside the %s range (%d to %d)\n", cells->name[conns->origin[i]], cells->name[conns->target[i]], conns->weight[i], encoding, lo, hi);
+      }
+    }
+  }
+
+  return bad == 0;
+}
+
+// Check everything the compact ROM format limits
+static uint8_t check_compact(const CellList* const cells, const ConnList* const conns, const uint32_t neurons) {
+  uint8_t ok = check_weights(cells, conns, -64, 63, "compact");
+
+  if(cells->len > 512) {
+    fprintf(stderr, "ctm_compile: %u cells, compact ids hold at most 512\n", cells->len);
+    ok = 0;
+  }
+
+  if((uint64_t)neurons + 2 + conns->len > UINT16_MAX) {
+    fprintf(stderr, "ctm_compile: %u ROM words, compact addresses reach at most %u\n", neurons + 2 + conns->len, UINT16_MAX);
+    ok = 0;
+  }
+
+  return ok;
+}
+
+// Longest cell name
+static uint32_t longest_name(const CellList* const cells) {
+  uint32_t longest = 0;
+
+  for(uint32_t i = 0; i < cells->len; i++) {
+    const uint32_t len = (uint32_t)strlen(cells->name[i]);
+    longest = len > longest ? len : longest;
+  }
+
+  return longest;
+}
+
+//
+// Output
+//
+
+static void write_rom(const char* path, const CtmNetwork* const net) {
+  uint32_t size;
+  uint16_t* rom = ctm_network_encode(net, CTM_ENCODING_COMPACT, &size);
+
+  FILE* f = fopen(path, "w");
+
+  if(rom == NULL || f == NULL) {
+    fail("can't write ", path);
+  }
+
+  fputs(
+    "// Word 0: Number of connected neurons (N_MAX)\n"
+    "// Word 1-(N_MAX): A address (offset from beginning) of each list of connections\n"
+    "// Word N_MAX+1: N_MAX plus the number of connections in the final neuron\n"
+    "// Word > (N_MAX+1): List of connections\n"
+    "\n"
+    "// Connection words are formatted as follows:\n"
+    "// Bit 0-7: Lower part of neuron index\n"
+    "// Bit 8: High part of neuron index (9-bits reserved for index)\n"
+    "// Bit 9-15: Weight of connection\n"
+    "\n"
+    "#include \"neural_rom.h\"\n"
+    "\n"
+    "const uint16_t NEURAL_ROM[] = {\n", f);
+
+  // Words are written as their value (the ROM is read
+  // as native words)
+  const uint32_t words = size/sizeof(uint16_t);
+
+  for(uint32_t i = 0; i < words; i++) {
+    if(i == words - 1) {
+      fprintf(f, "0x%04x\n};\n", rom[i]);
+    }
+    else {
+      fprintf(f, "0x%04x, ", rom[i]);
+
+      if(i % 15 == 14) {
+        fputc('\n', f);
+      }
+    }
+  }
+
+  fputs(
+    "\n"
+    "#ifdef CTM_NETWORK_FILE\n"
+    "// Cell names in id order (see CTM_NAME_LEN)\n"
+    "const char CELL_NAMES[][CTM_NAME_LEN] = {\n", f);
+
+  char line[128];
+  uint32_t line_len = 0;
+
+  for(CtmId i = 0; i < net->cells; i++) {
+    char token[CTM_NAME_LEN + 8];
+    const uint32_t token_len = (uint32_t)sprintf(token, "\"%s\"%s", ctm_network_cell_name(net, i), i + 1 < net->cells ? ", " : "");
+
+    if(line_len + token_len > 78) {
+      while(line_len > 0 && line[line_len - 1] == ' ') {
+        line_len--;
+      }
+      fprintf(f, "%.*s\n", (int)line_len, line);
+      line_len = 0;
+    }
+
+    memcpy(line + line_len, token, token_len);
+    line_len += token_len;
+  }
+
+  fprintf(f, "%.*s\n};\n#endif\n", (int)line_len, line);
+
+  if(fclose(f) != 0) {
+    fail("can't write ", path);
+  }
+
+  free(rom);
+}
+
+static void write_defines(const char* path, const CtmNetwork* const net) {
+  FILE* f = fopen(path, "w");
+
+  if(f == NULL) {
+    fail("can't write ", path);
+  }
+
+  fprintf(f, "// Total number of all cells\n#define CELLS %u\n\n", (unsigned)net->cells);
+
+  for(CtmId i = 0; i < net->cells; i++) {
+    fprintf(f, "#define N_%s %u\n", ctm_network_cell_name(net, i), (unsigned)i);
+  }
+
+  if(fclose(f) != 0) {
+    fail("can't write ", path);
+  }
+}
+
+int main(int argc, char** argv) {
+  const char* connectome_path = "CElegansNeuronTables/Connectome.csv";
+  const char* muscle_path = "CElegansNeuronTables/NeuronsToMuscle.csv";
+  const char* rom_path = NULL;
+  const char* defines_path = NULL;
+  const char* binary_path = NULL;
+  uint8_t encoding = CTM_ENCODING_COMPACT;
+  uint8_t locality = 0;
+  uint8_t verbose = 0;
+
+  int opt;
+
+  while((opt = getopt(argc, argv, "c:m:r:d:b:wlv")) != -1) {
+    switch(opt) {
+      case 'c': connectome_path = optarg; break;
+      case 'm': muscle_path = optarg; break;
+      case 'r': rom_path = optarg; break;
+      case 'd': defines_path = optarg; break;
+      case 'b': binary_path = optarg; break;
+      case 'w': encoding = CTM_ENCODING_WIDE; break;
+      case 'l': locality = 1; break;
+      case 'v': verbose = 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-c connectome.csv] [-m muscle.csv] [-r neural_rom.c] [-d cell_ids.h] [-b network.ctm] [-w] [-l] [-v]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  CellList cells;
+  ConnList conns;
+  memset(&cells, 0, sizeof(cells));
+  memset(&conns, 0, sizeof(conns));
+
+  // Connectome.csv: Origin, Target, Type, Number of
+  // Connections, Neurotransmitter
+  load_table(connectome_path, 3, 4, &cells, &conns);
+
+  // NeuronsToMuscle.csv: Neuron, Muscle, Number of
+  // Connections, Neurotransmitter
+  load_table(muscle_path, 2, 3, &cells, &conns);
+
+  uint32_t* order = xmalloc(cells.len*sizeof(uint32_t));
+  const uint32_t neurons = order_cells(&cells, &conns, locality, order);
+
+  // Check limits before writing anything
+  uint8_t ok = (CtmId)cells.len == cells.len;
+
+  if(!ok) {
+    fprintf(stderr, "ctm_compile: %u cells, %u-bit cell ids hold at most %llu\n", cells.len, (uint32_t)sizeof(CtmId)*8, (unsigned long long)(CtmId)-1);
+  }
+
+  if(rom_path != NULL || (binary_path != NULL && encoding == CTM_ENCODING_COMPACT)) {
+    ok = check_compact(&cells, &conns, neurons) && ok;
+  }
+  else {
+    ok = check_weights(&cells, &conns, INT16_MIN, INT16_MAX, "wide") && ok;
+  }
+
+  // The ROM source uses the compiled-in name width
+  const uint32_t longest = longest_name(&cells);
+
+  if(rom_path != NULL && longest >= CTM_NAME_LEN) {
+    fprintf(stderr, "ctm_compile: cell names of %u characters, the ROM source holds at most %u\n", longest, CTM_NAME_LEN - 1);
+    ok = 0;
+  }
+
+  if(!ok) {
+    return 1;
+  }
+
+  // Renumber cells, and lay connections out by origin
+  uint32_t* id = xmalloc(cells.len*sizeof(uint32_t));
+
+  for(uint32_t i = 0; i < cells.len; i++) {
+    id[order[i]] = i;
+  }
+
+  const uint32_t name_len = longest < CTM_NAME_LEN ? CTM_NAME_LEN : (longest + 4) & ~(uint32_t)3;
+  char* names = xcalloc(cells.len, name_len);
+
+  for(uint32_t i = 0; i < cells.len; i++) {
+    memcpy(names + (size_t)i*name_len, cells.name[order[i]], strlen(cells.name[order[i]]));
+  }
+
+  CtmSynapseTable t;
+  t.rows = neurons;
+  t.len = conns.len;
+  t.row_offset = xcalloc((size_t)neurons + 1, sizeof(uint32_t));
+  t.target = xmalloc(conns.len*sizeof(CtmId));
+  t.weight = xmalloc(conns.len*sizeof(CtmWeight));
+
+  for(uint32_t i = 0; i < conns.len; i++) {
+    t.row_offset[id[conns.origin[i]] + 1]++;
+  }
+  for(uint32_t i = 0; i < neurons; i++) {
+    t.row_offset[i + 1] += t.row_offset[i];
+  }
+
+  uint32_t* fill = xmalloc((size_t)neurons*sizeof(uint32_t));
+  memcpy(fill, t.row_offset, (size_t)neurons*sizeof(uint32_t));
+
+  for(uint32_t i = 0; i < conns.len; i++) {
+    const uint32_t pos = fill[id[conns.origin[i]]]++;
+
+    t.target[pos] = id[conns.target[i]];
+    t.weight[pos] = (CtmWeight)conns.weight[i];
+  }
+
+  CtmNetwork net;
+
+  if(!ctm_network_from_table(&net, &t, cells.len, names, name_len)) {
+    fail("out of memory", "");
+  }
+
+  if(verbose) {
+    int32_t heaviest = 0;
+
+    for(uint32_t i = 0; i < conns.len; i++) {
+      const int32_t w = conns.weight[i] < 0 ? -conns.weight[i] : conns.weight[i];
+      heaviest = w > heaviest ? w : heaviest;
+    }
+
+    fprintf(stderr, "%u cells (%u neurons), %u connections (%u listed more than once), largest weight %d\n", cells.len, neurons, conns.len, conns.repeated, heaviest);
+  }
+
+  if(rom_path != NULL) {
+    write_rom(rom_path, &net);
+  }
+
+  if(defines_path != NULL) {
+    write_defines(defines_path, &net);
+  }
+
+  if(binary_path != NULL && !ctm_network_save(&net, binary_path, encoding)) {
+    fail("can't write ", binary_path);
+  }
+
+  return 0;
+}
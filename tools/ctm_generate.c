@@ -0,0 +1,292 @@
+// Synthetic connectome generator
+//
+// Generates a network of any size (see synthetic.h) and
+// writes it out as a binary connectome file and/or as
+// OpenWorm-style tables that ctm_compile reads. Cells are
+// named N<i> (neurons), NM<i> (motor neurons) and M<i>
+// (muscles), with zero-padded numbers so that name order is
+// id order.
+//
+// Compile with:
+// gcc -O2 -I./source -o ./ctm_generate tools/ctm_generate.c source/synthetic.c source/network.c source/synapse_table.c source/wide_rom.c source/neural_rom.c -lm
+//
+// Usage:
+// ctm_generate [-n neurons] [-t motor] [-u muscles] [-s seed]
+//              [-d model|poisson|power] [-k mean] [-e exponent]
+//              [-x max_degree] [-i inhibitory] [-l locality]
+//              [-r span] [-m model.ctm] [-b network.ctm]
+//              [-c connectome.csv] [-M muscle.csv] [-w] [-v]
+//
+// -n: Number of neurons (defaults to 10000)
+// -t, -u, -i: Number of motor neurons and of muscles, and
+//             share of inhibitory neurons (default to the
+//             model network's proportions)
+// -s: Seed (defaults to 1)
+// -d: Degree distribution: resampled from the model
+//     (default), Poisson around -k, or a power law with
+//     exponent -e up to -x
+// -l, -r: Share of connections whose target is within -r
+//         ids of their origin (default to 0 and 64)
+// -m: Model network to resample from (defaults to the
+//     compiled-in one)
+// -b: Write a binary connectome file (compact encoding if
+//     the network fits it, wide otherwise)
+// -w: Always use the wide encoding for the binary file
+// -c, -M: Write the neuron and muscle tables
+// -v: Print a summary of the network
+//
+// Neurons that happen to have no connections at all come
+// out of the tables as muscles once compiled by
+// ctm_compile, which tells cells apart by their outputs.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "defines.h"
+#include "network.h"
+#include "synthetic.h"
+
+static void fail(const char* msg, const char* arg) {
+  fprintf(stderr, "ctm_generate: %s%s\n", msg, arg);
+  exit(1);
+}
+
+// Name of a cell, with numbers padded to the given width
+static void cell_name(char* const out, const size_t len, const CtmSyntheticParams* const p, const CtmId cell, const int width) {
+  if(cell < p->neurons - p->motor) {
+    snprintf(out, len, "N%0*u", width, cell);
+  }
+  else if(cell < p->neurons) {
+    snprintf(out, len, "NM%0*u", width, cell - (p->neurons - p->motor));
+  }
+  else {
+    snprintf(out, len, "M%0*u", width, cell - p->neurons);
+  }
+}
+
+// Write the connections of neurons (to_muscles clear) or
+// to muscles (set) in the layout of Connectome.csv or
+// NeuronsToMuscle.csv
+static void write_table(const char* path, const CtmNetwork* const net, const CtmSyntheticParams* const p, const uint8_t to_muscles) {
+  FILE* f = fopen(path, "w");
+
+  if(f == NULL) {
+    fail("can't write ", path);
+  }
+
+  fputs(to_muscles ? "Neuron,Muscle,Number of Connections,Neurotransmitter,\n" :
+    "Origin,Target,Type,Number of Connections,Neurotransmitter\n", f);
+
+  const CtmSynapseTable* const t = &net->_synapses;
+
+  for(CtmId row = 0; row < t->rows; row++) {
+    const char* origin = net->names + (size_t)row*net->name_len;
+
+    for(uint32_t i = t->row_offset[row]; i < t->row_offset[row + 1]; i++) {
+      if((t->target[i] >= p->neurons) != to_muscles) {
+        continue;
+      }
+
+      const char* target = net->names + (size_t)t->target[i]*net->name_len;
+      const int32_t w = t->weight[i];
+      const char* nt = w < 0 ? "GABA" : "Acetylcholine";
+
+      if(to_muscles) {
+        fprintf(f, "%s,%s,%d,%s,\n", origin, target, w < 0 ? -w : w, nt);
+      }
+      else {
+        fprintf(f, "%s,%s,Send,%d,%s\n", origin, target, w < 0 ? -w : w, nt);
+      }
+    }
+  }
+
+  if(fclose(f) != 0) {
+    fail("can't write ", path);
+  }
+}
+
+int main(int argc, char** argv) {
+  const char* model_path = NULL;
+  const char* binary_path = NULL;
+  const char* connectome_path = NULL;
+  const char* muscle_path = NULL;
+  uint8_t wide = 0;
+  uint8_t verbose = 0;
+
+  // Options are gathered first, since the defaults depend
+  // on the model and the number of neurons
+  CtmId neurons = 10000;
+  long motor = -1;
+  long muscles = -1;
+  double inhibitory = -1;
+  uint64_t seed = 1;
+  uint8_t degree = CTM_DEGREE_MODEL;
+  double mean = -1;
+  double exponent = -1;
+  long max_degree = -1;
+  double locality = 0;
+  CtmId span = 64;
+
+  int opt;
+
+  while((opt = getopt(argc, argv, "n:t:u:s:d:k:e:x:i:l:r:m:b:c:M:wv")) != -1) {
+    switch(opt) {
+      case 'n': neurons = (CtmId)strtoul(optarg, NULL, 10); break;
+      case 't': motor = strtol(optarg, NULL, 10); break;
+      case 'u': muscles = strtol(optarg, NULL, 10); break;
+      case 's': seed = strtoull(optarg, NULL, 10); break;
+      case 'd':
+        if(strcmp(optarg, "model") == 0) {
+          degree = CTM_DEGREE_MODEL;
+        }
+        else if(strcmp(optarg, "poisson") == 0) {
+          degree = CTM_DEGREE_POISSON;
+        }
+        else if(strcmp(optarg, "power") == 0) {
+          degree = CTM_DEGREE_POWER_LAW;
+        }
+        else {
+          fail("unknown degree distribution ", optarg);
+        }
+        break;
+      case 'k': mean = strtod(optarg, NULL); break;
+      case 'e': exponent = strtod(optarg, NULL); break;
+      case 'x': max_degree = strtol(optarg, NULL, 10); break;
+      case 'i': inhibitory = strtod(optarg, NULL); break;
+      case 'l': locality = strtod(optarg, NULL); break;
+      case 'r': span = (CtmId)strtoul(optarg, NULL, 10); break;
+      case 'm': model_path = optarg; break;
+      case 'b': binary_path = optarg; break;
+      case 'c': connectome_path = optarg; break;
+      case 'M': muscle_path = optarg; break;
+      case 'w': wide = 1; break;
+      case 'v': verbose = 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-n neurons] [-t motor] [-u muscles] [-s seed] [-d model|poisson|power] [-k mean] [-e exponent] [-x max_degree] [-i inhibitory] [-l locality] [-r span] [-m model.ctm] [-b network.ctm] [-c connectome.csv] [-M muscle.csv] [-w] [-v]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  CtmNetwork model;
+  const CtmNetwork* model_net = NULL;
+
+  if(model_path != NULL) {
+    if(!ctm_network_open(&model, model_path)) {
+      fail("can't open model network ", model_path);
+    }
+
+    model_net = &model;
+  }
+
+  CtmSyntheticParams p;
+  ctm_synthetic_default_params(&p, model_net, neurons);
+
+  p.seed = seed;
+  p.degree = degree;
+  p.locality = locality;
+  p.span = span;
+
+  if(motor >= 0) {
+    p.motor = (CtmId)motor;
+  }
+  if(muscles >= 0) {
+    p.muscles = (CtmId)muscles;
+  }
+  if(inhibitory >= 0) {
+    p.inhibitory = inhibitory;
+  }
+  if(mean >= 0) {
+    p.mean_degree = mean;
+  }
+  if(exponent >= 0) {
+    p.exponent = exponent;
+  }
+  if(max_degree >= 0) {
+    p.max_degree = (uint32_t)max_degree;
+  }
+
+  CtmSynapseTable t;
+
+  if(!ctm_synthetic_table(&t, &p)) {
+    fail("invalid parameters, or out of memory", "");
+  }
+
+  // Names, wide enough for the largest number
+  const CtmId cells = p.neurons + p.muscles;
+  char digits[16];
+  const int width = snprintf(digits, sizeof(digits), "%u", p.neurons > p.muscles ? p.neurons : p.muscles);
+
+  const uint32_t longest = 2 + width;
+  const uint32_t name_len = longest < CTM_NAME_LEN ? CTM_NAME_LEN : (longest + 4) & ~(uint32_t)3;
+  char* names = calloc(cells, name_len);
+
+  if(names == NULL) {
+    fail("out of memory", "");
+  }
+
+  for(CtmId i = 0; i < cells; i++) {
+    cell_name(names + (size_t)i*name_len, name_len, &p, i, width);
+  }
+
+  CtmNetwork net;
+
+  if(!ctm_network_from_table(&net, &t, cells, names, name_len)) {
+    fail("out of memory", "");
+  }
+
+  if(verbose) {
+    const CtmSynapseTable* const s = &net._synapses;
+    uint32_t inhibitory_neurons = 0;
+    uint32_t to_muscles = 0;
+
+    for(CtmId row = 0; row < s->rows; row++) {
+      const uint32_t first = s->row_offset[row];
+
+      inhibitory_neurons += first < s->row_offset[row + 1] && s->weight[first] < 0;
+
+      for(uint32_t i = first; i < s->row_offset[row + 1]; i++) {
+        to_muscles += s->target[i] >= p.neurons;
+      }
+    }
+
+    fprintf(stderr, "%u cells (%u neurons, %u of them motor), %u connections (%u to muscles, %.2f per neuron), %u neurons with inhibitory outputs, hash %016llx\n",
+      cells, p.neurons, p.motor, s->len, to_muscles, (double)s->len/p.neurons, inhibitory_neurons,
+      (unsigned long long)ctm_network_hash(&net));
+  }
+
+  if(binary_path != NULL) {
+    uint8_t encoding = CTM_ENCODING_WIDE;
+
+    if(!wide) {
+      uint32_t size;
+      void* compact = ctm_network_encode(&net, CTM_ENCODING_COMPACT, &size);
+
+      encoding = compact != NULL ? CTM_ENCODING_COMPACT : CTM_ENCODING_WIDE;
+      free(compact);
+    }
+
+    if(!ctm_network_save(&net, binary_path, encoding)) {
+      fail("can't write ", binary_path);
+    }
+  }
+
+  if(connectome_path != NULL) {
+    write_table(connectome_path, &net, &p, 0);
+  }
+
+  if(muscle_path != NULL) {
+    write_table(muscle_path, &net, &p, 1);
+  }
+
+  ctm_network_close(&net);
+  free(names);
+
+  if(model_net != NULL) {
+    ctm_network_close(&model);
+  }
+
+  return 0;
+}
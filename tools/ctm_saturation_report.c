@@ -0,0 +1,289 @@
+// Deferred saturation equivalence report
+//
+// Runs the compiled-in network with and without
+// CTM_MODE_DEFERRED_SATURATION side by side under the
+// stimuli of test/main.c, and reports for each scenario
+// where and how much the two diverge: the first tick their
+// states and discharges differ, how many ticks discharge
+// alike, how far the motor neuron firing rates and the
+// locomotion decisions drift apart, and which neurons
+// differ most often
+//
+// Each scenario starts from the same state in both modes,
+// after a burn-in under the chemotaxis stimulus (as in
+// test/main.c) in the default mode
+//
+// Compile with:
+// gcc -O2 -I./source -o ./ctm_saturation_report tools/ctm_saturation_report.c source/*.c -lpthread -lm
+//
+// Usage:
+// ctm_saturation_report [-t ticks] [-b burn_in] [-n neurons]
+//
+// -t: Ticks per scenario (defaults to 10000)
+// -b: Burn-in ticks (defaults to 1000)
+// -n: Number of most divergent neurons listed (defaults
+//     to 10)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "defines.h"
+#include "connectome.h"
+#include "group.h"
+#include "locomotion.h"
+#include "muscles.h"
+
+static const CtmId nose_touch[] = {
+  N_FLPR, N_FLPL, N_ASHL, N_ASHR, N_IL1VL, N_IL1VR,
+  N_OLQDL, N_OLQDR, N_OLQVR, N_OLQVL
+};
+
+static const CtmId chemotaxis[] = {
+  N_ADFL, N_ADFR, N_ASGR, N_ASGL, N_ASIL, N_ASIR,
+  N_ASJR, N_ASJL
+};
+
+#define LEN(A) (sizeof(A)/sizeof(A[0]))
+
+// Ticks of each stimulus in the alternating scenario
+#define ALTERNATE_TICKS 1000
+
+typedef struct {
+  const char* name;
+  const CtmId* stimulus;
+  CtmId len;
+
+  // Alternate with nose touch every ALTERNATE_TICKS
+  uint8_t alternate;
+} Scenario;
+
+static const Scenario scenarios[] = {
+  { "quiescent", NULL, 0, 0 },
+  { "chemotaxis", chemotaxis, LEN(chemotaxis), 0 },
+  { "nose_touch", nose_touch, LEN(nose_touch), 0 },
+  { "alternating", chemotaxis, LEN(chemotaxis), 1 }
+};
+
+// One side of the comparison
+typedef struct {
+  Connectome c;
+  CtmLocomotion loco;
+
+  uint64_t discharges;
+  uint64_t motor_a;
+  uint64_t motor_b;
+  uint32_t reverse_ticks;
+} Side;
+
+static void side_init(Side* const s, const CtmNetwork* const net, const uint8_t mode, const uint32_t burn_in) {
+  memset(s, 0, sizeof(*s));
+
+  ctm_init(&s->c, net);
+  ctm_set_mode(&s->c, CTM_MODE_EVENT_DRIVEN);
+
+  // Burn-in is in the default mode on both sides
+  for(uint32_t t = 0; t < burn_in; t++) {
+    ctm_neural_cycle(&s->c, chemotaxis, LEN(chemotaxis));
+  }
+
+  ctm_set_mode(&s->c, mode);
+
+  CtmLocomotionParams p;
+  ctm_locomotion_default_params(&p);
+  ctm_locomotion_init(&s->loco, net, &p);
+}
+
+static void side_free(Side* const s) {
+  ctm_free(&s->c);
+  ctm_locomotion_free(&s->loco);
+}
+
+// Update the decoder with one tick's discharges, and tally
+// them
+static void side_count(Side* const s) {
+  ctm_locomotion_update(&s->loco, &s->c);
+
+  const CtmId words = CTM_BITSET_WORDS(s->c._neurons_tot);
+
+  for(CtmId w = 0; w < words; w++) {
+    s->discharges += __builtin_popcountll(s->c._discharged[w]);
+  }
+
+  s->motor_a += ctm_group_discharges(&s->c, &s->loco._motor_a);
+  s->motor_b += ctm_group_discharges(&s->c, &s->loco._motor_b);
+  s->reverse_ticks += s->loco.state == CTM_LOCOMOTION_REVERSE;
+}
+
+typedef struct {
+  CtmId id;
+  uint32_t ticks;
+} NeuronDiff;
+
+static int compare_diff(const void* a, const void* b) {
+  const NeuronDiff* x = a;
+  const NeuronDiff* y = b;
+
+  if(x->ticks != y->ticks) {
+    return (x->ticks < y->ticks) - (x->ticks > y->ticks);
+  }
+
+  return (x->id > y->id) - (x->id < y->id);
+}
+
+static void report(const CtmNetwork* const net, const Scenario* const sc, const uint32_t ticks, const uint32_t burn_in, const uint32_t top) {
+  const CtmId n = net->neurons;
+  const CtmId words = CTM_BITSET_WORDS(n);
+
+  Side ref;
+  Side def;
+  side_init(&ref, net, CTM_MODE_EVENT_DRIVEN, burn_in);
+  side_init(&def, net, CTM_MODE_EVENT_DRIVEN | CTM_MODE_DEFERRED_SATURATION, burn_in);
+
+  NeuronDiff* diff = malloc(n*sizeof(NeuronDiff));
+
+  for(CtmId i = 0; i < n; i++) {
+    diff[i].id = i;
+    diff[i].ticks = 0;
+  }
+
+  int64_t first_state = -1;
+  int64_t first_discharge = -1;
+  uint32_t same_states = 0;
+  uint32_t same_ticks = 0;
+  uint32_t same_decision = 0;
+  uint64_t hamming = 0;
+
+  for(uint32_t t = 0; t < ticks; t++) {
+    const CtmId* stim = sc->stimulus;
+    CtmId len = sc->len;
+
+    if(sc->alternate && (t/ALTERNATE_TICKS) % 2 == 1) {
+      stim = nose_touch;
+      len = LEN(nose_touch);
+    }
+
+    ctm_neural_cycle(&ref.c, stim, len);
+    ctm_neural_cycle(&def.c, stim, len);
+
+    side_count(&ref);
+    side_count(&def);
+
+    if(memcmp(ctm_neuron_state(&ref.c), ctm_neuron_state(&def.c), n) == 0 &&
+        memcmp(ctm_muscle_state(&ref.c), ctm_muscle_state(&def.c), (net->cells - n)*sizeof(int16_t)) == 0) {
+      same_states++;
+    }
+    else if(first_state < 0) {
+      first_state = t;
+    }
+
+    uint32_t differ = 0;
+
+    for(CtmId w = 0; w < words; w++) {
+      CtmBitWord bits = ref.c._discharged[w] ^ def.c._discharged[w];
+
+      differ += __builtin_popcountll(bits);
+
+      while(bits) {
+        diff[w*CTM_BITS_PER_WORD + ctm_bitword_lowest(bits)].ticks++;
+        bits &= bits - 1;
+      }
+    }
+
+    if(differ == 0) {
+      same_ticks++;
+    }
+    else if(first_discharge < 0) {
+      first_discharge = t;
+    }
+
+    hamming += differ;
+    same_decision += ref.loco.state == def.loco.state;
+  }
+
+  printf("%s (%u ticks after %u of burn-in)\n", sc->name, ticks, burn_in);
+
+  if(first_state < 0) {
+    printf("  states never diverge\n");
+  }
+  else {
+    printf("  first tick with different states: %lld\n", (long long)first_state);
+  }
+
+  if(first_discharge < 0) {
+    printf("  discharges never diverge\n");
+  }
+  else {
+    printf("  first tick with different discharges: %lld\n", (long long)first_discharge);
+  }
+
+  printf("  ticks with identical states: %u (%.1f%%)\n", same_states, 100.0*same_states/ticks);
+  printf("  ticks with identical discharges: %u (%.1f%%)\n", same_ticks, 100.0*same_ticks/ticks);
+  printf("  neurons discharging differently per tick: %.2f\n", (double)hamming/ticks);
+  printf("  discharges per tick: default %.2f, deferred %.2f\n", (double)ref.discharges/ticks, (double)def.discharges/ticks);
+
+  const double a_scale = 100.0/((double)ticks*ref.loco._motor_a.neurons);
+  const double b_scale = 100.0/((double)ticks*ref.loco._motor_b.neurons);
+
+  printf("  A-type motor neurons firing: default %.2f%%, deferred %.2f%%\n", ref.motor_a*a_scale, def.motor_a*a_scale);
+  printf("  B-type motor neurons firing: default %.2f%%, deferred %.2f%%\n", ref.motor_b*b_scale, def.motor_b*b_scale);
+  printf("  ticks in reverse: default %u, deferred %u\n", ref.reverse_ticks, def.reverse_ticks);
+  printf("  ticks with the same locomotion decision: %.1f%%\n", 100.0*same_decision/ticks);
+
+  qsort(diff, n, sizeof(NeuronDiff), compare_diff);
+
+  if(top > 0 && diff[0].ticks > 0) {
+    printf("  neurons differing most often:\n");
+
+    for(uint32_t i = 0; i < top && i < n && diff[i].ticks > 0; i++) {
+      const char* name = ctm_network_cell_name(net, diff[i].id);
+
+      printf("    %-8s %u ticks\n", name != NULL ? name : "?", diff[i].ticks);
+    }
+  }
+
+  printf("\n");
+
+  free(diff);
+  side_free(&ref);
+  side_free(&def);
+}
+
+int main(int argc, char** argv) {
+  uint32_t ticks = 10000;
+  uint32_t burn_in = 1000;
+  uint32_t top = 10;
+
+  int opt;
+
+  while((opt = getopt(argc, argv, "t:b:n:")) != -1) {
+    switch(opt) {
+      case 't': ticks = (uint32_t)strtoul(optarg, NULL, 10); break;
+      case 'b': burn_in = (uint32_t)strtoul(optarg, NULL, 10); break;
+      case 'n': top = (uint32_t)strtoul(optarg, NULL, 10); break;
+      default:
+        fprintf(stderr, "usage: %s [-t ticks] [-b burn_in] [-n neurons]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if(ticks == 0) {
+    ticks = 1;
+  }
+
+  CtmNetwork net;
+
+  if(!ctm_network_builtin(&net)) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  for(uint32_t s = 0; s < LEN(scenarios); s++) {
+    report(&net, &scenarios[s], ticks, burn_in, top);
+  }
+
+  ctm_network_close(&net);
+
+  return 0;
+}
@@ -0,0 +1,101 @@
+// Discharge trace converter
+//
+// Writes a binary discharge trace (see trace.h) out in the
+// text format of motor_ab.dat, as read by the scripts in
+// python_plotting: one line per tick, holding a 0 or 1 for
+// each traced neuron in order, separated by spaces
+//
+// Compile with:
+// gcc -O2 -I./source -o ./ctm_trace_dat tools/ctm_trace_dat.c source/trace.c source/connectome.c source/kernels.c source/network.c source/synapse_table.c source/wide_rom.c source/neural_rom.c source/pool.c -lpthread
+//
+// Usage:
+// ctm_trace_dat [-o motor_ab.dat] [-s first_tick] [-n ticks] trace
+//
+// -o: Output file (defaults to motor_ab.dat)
+// -s: First tick to write (found through the trace's
+//     index rather than by decoding everything before it)
+// -n: Number of ticks to write (defaults to the rest of
+//     the trace)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "defines.h"
+#include "trace.h"
+
+int main(int argc, char** argv) {
+  const char* out_path = "motor_ab.dat";
+  uint32_t first = 0;
+  uint32_t ticks = UINT32_MAX;
+
+  int opt;
+
+  while((opt = getopt(argc, argv, "o:s:n:")) != -1) {
+    switch(opt) {
+      case 'o': out_path = optarg; break;
+      case 's': first = (uint32_t)strtoul(optarg, NULL, 10); break;
+      case 'n': ticks = (uint32_t)strtoul(optarg, NULL, 10); break;
+      default: optind = argc + 1; break;
+    }
+  }
+
+  if(optind != argc - 1) {
+    fprintf(stderr, "usage: %s [-o motor_ab.dat] [-s first_tick] [-n ticks] trace\n", argv[0]);
+    return 1;
+  }
+
+  CtmTraceReader r;
+
+  if(!ctm_trace_read_open(&r, argv[optind])) {
+    fprintf(stderr, "ctm_trace_dat: can't read trace %s\n", argv[optind]);
+    return 1;
+  }
+
+  if(!ctm_trace_seek(&r, first)) {
+    fprintf(stderr, "ctm_trace_dat: trace ends before tick %u\n", first);
+    ctm_trace_read_close(&r);
+    return 1;
+  }
+
+  FILE* f = fopen(out_path, "w");
+
+  if(f == NULL) {
+    fprintf(stderr, "ctm_trace_dat: can't write %s\n", out_path);
+    ctm_trace_read_close(&r);
+    return 1;
+  }
+
+  CtmBitWord* bits = malloc((CTM_BITSET_WORDS(r.len) + 1)*sizeof(CtmBitWord));
+
+  // Lines are built whole, each bit taking a digit and a
+  // separator
+  char* line = malloc(2*(size_t)r.len + 1);
+
+  uint32_t t = 0;
+
+  for(; t < ticks && r.len > 0 && ctm_trace_read(&r, bits); t++) {
+    for(CtmId i = 0; i < r.len; i++) {
+      line[2*i] = '0' + ctm_bitset_get(bits, i);
+      line[2*i + 1] = ' ';
+    }
+    line[2*r.len - 1] = '\n';
+
+    fwrite(line, 2*r.len, 1, f);
+  }
+
+  uint8_t ok = fclose(f) == 0;
+
+  // Indexed traces know how long they are
+  if(r.ticks != 0 && t < ticks && r.tick < r.ticks) {
+    fprintf(stderr, "ctm_trace_dat: trace is malformed at tick %u\n", r.tick);
+    ok = 0;
+  }
+
+  free(bits);
+  free(line);
+  ctm_trace_read_close(&r);
+
+  return ok ? 0 : 1;
+}